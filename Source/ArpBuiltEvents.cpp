@@ -15,9 +15,10 @@
 // along with this program.  If not, see https://librearp.gitlab.io/license/.
 //
 
+#include <algorithm>
 #include "ArpBuiltEvents.h"
 
-ArpBuiltEvents::EventNoteData ArpBuiltEvents::EventNoteData::of(NoteData &orig, unsigned long noteIndex) {
+ArpBuiltEvents::EventNoteData ArpBuiltEvents::EventNoteData::of(const NoteData &orig, unsigned long noteIndex) {
     EventNoteData result;
     result.noteNumber = orig.noteNumber;
     result.velocity = orig.velocity;
@@ -26,3 +27,61 @@ ArpBuiltEvents::EventNoteData ArpBuiltEvents::EventNoteData::of(NoteData &orig,
 
     return result;
 }
+
+
+size_t ArpBuiltEvents::getNumEvents() const {
+    return this->times.size();
+}
+
+ArpBuiltEvents::IndexRange ArpBuiltEvents::getOffs(size_t event) const {
+    auto base = this->indices.data();
+    return IndexRange { base + this->offsets[2 * event], base + this->offsets[2 * event + 1] };
+}
+
+ArpBuiltEvents::IndexRange ArpBuiltEvents::getOns(size_t event) const {
+    auto base = this->indices.data();
+    return IndexRange { base + this->offsets[2 * event + 1], base + this->offsets[2 * event + 2] };
+}
+
+
+void ArpBuiltEvents::insertEntry(int64 time, bool isOn, uint32 dataIndex) {
+    auto it = std::lower_bound(this->times.begin(), this->times.end(), time);
+    auto event = static_cast<size_t>(it - this->times.begin());
+    if (it == this->times.end() || *it != time) {
+        // The new event starts where the event it is inserted before started, with empty ranges
+        this->times.insert(it, time);
+        auto start = this->offsets[2 * event];
+        this->offsets.insert(this->offsets.begin() + 2 * event + 1, 2, start);
+    }
+
+    auto rangeEnd = 2 * event + (isOn ? 2 : 1);
+    auto first = this->indices.begin() + this->offsets[rangeEnd - 1];
+    auto last = this->indices.begin() + this->offsets[rangeEnd];
+    this->indices.insert(std::lower_bound(first, last, dataIndex), dataIndex);
+
+    for (auto i = rangeEnd; i < this->offsets.size(); i++) {
+        this->offsets[i]++;
+    }
+}
+
+void ArpBuiltEvents::removeEntry(int64 time, bool isOn, uint32 dataIndex) {
+    auto it = std::lower_bound(this->times.begin(), this->times.end(), time);
+    jassert(it != this->times.end() && *it == time);
+    auto event = static_cast<size_t>(it - this->times.begin());
+
+    auto rangeEnd = 2 * event + (isOn ? 2 : 1);
+    auto first = this->indices.begin() + this->offsets[rangeEnd - 1];
+    auto last = this->indices.begin() + this->offsets[rangeEnd];
+    auto entry = std::lower_bound(first, last, dataIndex);
+    jassert(entry != last && *entry == dataIndex);
+    this->indices.erase(entry);
+
+    for (auto i = rangeEnd; i < this->offsets.size(); i++) {
+        this->offsets[i]--;
+    }
+
+    if (this->offsets[2 * event] == this->offsets[2 * event + 2]) {
+        this->times.erase(it);
+        this->offsets.erase(this->offsets.begin() + 2 * event + 1, this->offsets.begin() + 2 * event + 3);
+    }
+}
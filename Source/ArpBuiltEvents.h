@@ -17,37 +17,42 @@
 
 #pragma once
 
-#include <set>
+#include <vector>
 #include "JuceHeader.h"
 #include "NoteData.h"
+#include "ArpIntervalIndex.h"
 
 /**
  * A data class of built events of a pattern, ready for playback.
+ *
+ * The events are stored in a compressed sparse row layout. Event i fires at times[i], the indices of its off-data are
+ * indices[offsets[2i]] to indices[offsets[2i + 1] - 1] and the indices of its on-data are indices[offsets[2i + 1]] to
+ * indices[offsets[2i + 2] - 1]. All the arrays are contiguous and hold plain data only.
  */
 class ArpBuiltEvents {
 public:
 
     /**
-     * Data class of a single event in time. Contains the time the event fires (in the set timebase) and indices of
-     * on-data and off-data.
+     * A range of on-data or off-data indices of a single event.
      */
-    class Event {
+    class IndexRange {
     public:
 
         /**
-         * The time in the pattern on which the event fires.
+         * Pointer to the first index of the range.
          */
-        int64 time;
+        const uint32 *first;
 
         /**
-         * The indices of on-data.
+         * Pointer past the last index of the range.
          */
-        std::set<unsigned long> ons;
+        const uint32 *last;
 
-        /**
-         * The indices of off-data.
-         */
-        std::set<unsigned long> offs;
+        const uint32 *begin() const { return first; }
+
+        const uint32 *end() const { return last; }
+
+        size_t size() const { return static_cast<size_t>(last - first); }
     };
 
 
@@ -80,6 +85,22 @@ public:
          */
         int lastNote = -1;
 
+        /**
+         * The position of the voice played by the note in the voice table, or -1 if it is not playing.
+         */
+        int voice = -1;
+
+        /**
+         * The output MIDI note number the note resolves to with the current input chord. Only valid if
+         * resolvedGeneration matches the generation of the player.
+         */
+        int resolvedNote = -1;
+
+        /**
+         * The chord generation resolvedNote has been computed for. Zero if it has never been computed.
+         */
+        uint32 resolvedGeneration = 0;
+
         /**
          * The index of the note in the pattern from which the events were built.
          */
@@ -93,21 +114,38 @@ public:
          * @param orig
          * @return
          */
-        static EventNoteData of(NoteData &orig, unsigned long noteIndex);
+        static EventNoteData of(const NoteData &orig, unsigned long noteIndex);
     };
 
 
 
     /**
-     * The event data.
+     * The times in the pattern on which the events fire, in ascending order.
+     */
+    std::vector<int64> times;
+
+    /**
+     * The offsets of the off-data and on-data index ranges of the events in the index array. Contains
+     * 2 * times.size() + 1 entries.
+     */
+    std::vector<uint32> offsets;
+
+    /**
+     * The packed off-data and on-data indices of all the events.
      */
-    std::vector<Event> events;
+    std::vector<uint32> indices;
 
     /**
      * The data of notes in the pattern.
      */
     std::vector<EventNoteData> data;
 
+    /**
+     * The index of the intervals the notes sound in within a loop iteration, used to chase the notes that should be
+     * sounding when playback starts in the middle of them.
+     */
+    ArpIntervalIndex intervals;
+
 
 
     /**
@@ -119,6 +157,50 @@ public:
      * The loop length of the built pattern.
      */
     int64 loopLength;
+
+
+
+    /**
+     * Gets the number of events.
+     *
+     * @return the number of events
+     */
+    size_t getNumEvents() const;
+
+    /**
+     * Gets the indices of the off-data of the specified event.
+     *
+     * @param event the index of the event
+     * @return the indices of the off-data
+     */
+    IndexRange getOffs(size_t event) const;
+
+    /**
+     * Gets the indices of the on-data of the specified event.
+     *
+     * @param event the index of the event
+     * @return the indices of the on-data
+     */
+    IndexRange getOns(size_t event) const;
+
+    /**
+     * Inserts an off or an on of a note data, adding its event if there is none at the time yet. The indices of an
+     * event stay sorted, so the result is the same as if the events had been built with the entry.
+     *
+     * @param time the time in the pattern
+     * @param isOn whether the entry is an on
+     * @param dataIndex the index of the note data
+     */
+    void insertEntry(int64 time, bool isOn, uint32 dataIndex);
+
+    /**
+     * Removes an off or an on of a note data, removing its event if it has no entries left.
+     *
+     * @param time the time in the pattern
+     * @param isOn whether the entry is an on
+     * @param dataIndex the index of the note data
+     */
+    void removeEntry(int64 time, bool isOn, uint32 dataIndex);
 };
 
 
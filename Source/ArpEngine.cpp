@@ -0,0 +1,600 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "ArpEngine.h"
+#include "debug/AllocationTracker.h"
+
+const Identifier ArpEngine::TREEID_LOOP_RESET = Identifier("loopReset"); // NOLINT
+const Identifier ArpEngine::TREEID_OCTAVES = Identifier("octaves"); // NOLINT
+const Identifier ArpEngine::TREEID_NUM_INPUT_NOTES = Identifier("numInputNotes"); // NOLINT
+const Identifier ArpEngine::TREEID_OUTPUT_MIDI_CHANNEL = Identifier("outputMidiChannel"); // NOLINT
+const Identifier ArpEngine::TREEID_INPUT_MIDI_CHANNEL = Identifier("inputMidiChannel"); // NOLINT
+const Identifier ArpEngine::TREEID_TRANSPOSE = Identifier("transpose"); // NOLINT
+const Identifier ArpEngine::TREEID_VELOCITY_SCALING = Identifier("velocityScaling"); // NOLINT
+const Identifier ArpEngine::TREEID_DETERMINISTIC = Identifier("deterministic"); // NOLINT
+
+const int NUM_MIDI_NOTES = 128;
+const int MIDI_EVENT_SIZE = 9; // 3 bytes of data + sample position and size in MidiBuffer
+const int NON_REALTIME_BUILD_TIMEOUT_MS = 1000;
+const int RESOLVE_BATCH_SIZE = 64;
+const double MAX_VELOCITY = 127.0;
+
+ArpEngine::ArpEngine() {
+    this->events = new ArpBuiltEvents(ArpPattern().buildEvents());
+    this->tempoMap.setTimebase(this->events->timebase);
+    this->octaves = true;
+    this->loopReset = 0.0;
+    this->outputMidiChannel = 1;
+    this->velocityScaling = false;
+    this->deterministic = false;
+    this->lastPosition = 0;
+    this->lastEndPulse = 0.0;
+    this->lastWindowEnd = 0;
+    this->sampleClock = 0;
+    this->anchorSample = 0;
+    this->anchorPulse = 0.0;
+    this->anchorPulseSamples = 0.0;
+    this->wasPlaying = false;
+    this->stopScheduled = false;
+    this->idle = false;
+    this->numInputNotes = 0;
+    this->resolvedGeneration = 1;
+    this->resolvedInputVersion = this->inputNotes.getVersion();
+    this->resolvedOctaves = this->octaves;
+    this->timeSigNumerator = 4;
+    this->timeSigDenominator = 4;
+    this->playbackChanged = true;
+
+    inputFilter.addStage(channelFilter);
+    inputFilter.addStage(transpose);
+    inputFilter.addStage(velocityCapture);
+}
+
+ArpEngine::~ArpEngine() {
+    delete this->events;
+}
+
+
+void ArpEngine::prepare(double sampleRate, int maxBlockSize) {
+    this->tempoMap.prepare(sampleRate);
+
+    // Size the output merge buffer for the host's messages plus the generated notes of a busy block, so that
+    // merging never reallocates
+    output.prepare(jmax(maxBlockSize, NUM_MIDI_NOTES) * MIDI_EVENT_SIZE * 4);
+}
+
+void ArpEngine::process(const Transport &transport, int numSamples, MidiBuffer &midi, bool nonRealtime) {
+    LIBREARP_AUDIO_THREAD_SCOPE("process");
+
+    output.begin(midi);
+
+    // Switch to newly built events, if there are any. The voices refer to the note data of the old events, so they
+    // are moved over to the new ones before the switch.
+    if (nonRealtime) {
+        compiler.waitForBuilds(NON_REALTIME_BUILD_TIMEOUT_MS);
+    }
+
+    if (compiler.canSwap()) {
+        auto oldTimebase = this->events->timebase;
+        auto fresh = compiler.acquire();
+        this->migrateVoices(*fresh);
+        compiler.retire(this->events);
+        this->events = fresh;
+        this->tempoMap.setTimebase(this->events->timebase);
+        this->scheduler.reset();
+        this->lastEndPulse *= static_cast<double>(this->events->timebase) / oldTimebase;
+    }
+
+    if (transport.timeSigNumerator != this->timeSigNumerator
+            || transport.timeSigDenominator != this->timeSigDenominator) {
+        this->timeSigNumerator = transport.timeSigNumerator;
+        this->timeSigDenominator = transport.timeSigDenominator;
+        this->playbackChanged = true;
+    }
+
+    if (transport.isPlaying && !this->events->times.empty()) {
+        auto timebase = this->events->timebase;
+        auto pulseSamples = tempoMap.getPulseSamples(transport.bpm);
+
+        // Events are timed in fractional pulses, so that their sample offsets do not depend on how the pulses fall
+        // onto block boundaries. A block starting less than a sample away from where the last one ended is taken as
+        // its continuation, which keeps hosts' rounding of the position from dropping or doubling events.
+        auto startPulse = transport.ppqPosition * timebase;
+        auto continuous = this->wasPlaying && std::abs(startPulse - this->lastEndPulse) * pulseSamples < 1.0;
+        if (continuous) {
+            startPulse = this->lastEndPulse;
+        }
+
+        Window window; // NOLINT
+        window.resetLength = (loopReset > 0.0) ? static_cast<int64>(std::ceil(timebase * loopReset)) : 0;
+        window.numSamples = numSamples;
+        if (deterministic) {
+            // The positions of the events are derived from a sample clock anchored where the playback started or the
+            // tempo last changed, so they do not depend on the block sizes at all
+            if (!continuous || pulseSamples != this->anchorPulseSamples) {
+                this->anchorSample = this->sampleClock;
+                this->anchorPulse = startPulse;
+                this->anchorPulseSamples = pulseSamples;
+            }
+            tempoMap.begin(this->anchorPulse, this->anchorSample - this->sampleClock, this->anchorPulseSamples);
+        } else {
+            tempoMap.begin(startPulse, 0, pulseSamples);
+        }
+
+        for (int i = 0; i < transport.numTempoChanges; i++) {
+            auto &change = transport.tempoChanges[i];
+            if (change.sample > 0 && change.sample < numSamples) {
+                tempoMap.changeTempo(change.sample, tempoMap.getPulseSamples(change.bpm));
+            }
+        }
+
+        if (deterministic) {
+            // The timing carries on from the last tempo change, which is where the same sample clock anchors it
+            // however the blocks are split
+            auto &segment = tempoMap.getLastSegment();
+            this->anchorSample = this->sampleClock + segment.startOffset;
+            this->anchorPulse = segment.startPulse;
+            this->anchorPulseSamples = segment.pulseSamples;
+        }
+        window.to = continuous ? this->lastWindowEnd : tempoMap.getFirstPulse(0);
+
+        if (stopScheduled) {
+            this->stopVoices();
+            stopScheduled = false;
+        }
+
+        // In deterministic mode, the block is split at the input notes so that they take effect at their exact
+        // sample; otherwise, they all take effect at the start of the block
+        int segmentEnd = 0;
+        processInputMidi(midi, [&](int sample, const ArpInputStage::Note &note) {
+            sample = jlimit(segmentEnd, numSamples, sample);
+            if (deterministic && sample > segmentEnd) {
+                processSegment(window, sample);
+                segmentEnd = sample;
+            }
+            consumeInputNote(note);
+        });
+        processSegment(window, numSamples);
+
+        auto endPulse = tempoMap.getPulse(numSamples);
+        auto position = static_cast<int64>(std::floor(endPulse));
+        if (this->lastPosition != position) {
+            this->lastPosition = position;
+            this->playbackChanged = true;
+        }
+        this->lastEndPulse = endPulse;
+        this->lastWindowEnd = window.to;
+        this->wasPlaying = true;
+    } else {
+        processInputMidi(midi, [&](int, const ArpInputStage::Note &note) {
+            consumeInputNote(note);
+        });
+
+        if (this->wasPlaying) {
+            this->stopVoices();
+            this->lastPosition = 0;
+        }
+
+        this->wasPlaying = false;
+        this->idle = false;
+        this->scheduler.reset();
+    }
+    this->sampleClock += numSamples;
+
+    output.flush();
+
+    if (this->playbackChanged) {
+        publishPlaybackState();
+        this->playbackChanged = false;
+    }
+}
+
+void ArpEngine::stopAll() {
+    this->stopScheduled = true;
+}
+
+void ArpEngine::compile(ArpPattern &pattern) {
+    compiler.compile(std::make_shared<const ArpPattern>(pattern));
+}
+
+void ArpEngine::compile(std::shared_ptr<const ArpPattern> pattern) {
+    compiler.compile(std::move(pattern));
+}
+
+void ArpEngine::compile(std::shared_ptr<const ArpPattern> pattern, const std::vector<uint64> &changedNotes) {
+    compiler.compile(std::move(pattern), changedNotes);
+}
+
+void ArpEngine::reclaimEvents() {
+    compiler.reclaimRetired();
+}
+
+
+void ArpEngine::writeState(ValueTree &tree) {
+    tree.setProperty(TREEID_LOOP_RESET, this->loopReset, nullptr);
+    tree.setProperty(TREEID_OCTAVES, this->octaves.load(), nullptr);
+    tree.setProperty(TREEID_NUM_INPUT_NOTES, this->numInputNotes, nullptr);
+    tree.setProperty(TREEID_OUTPUT_MIDI_CHANNEL, this->outputMidiChannel, nullptr);
+    tree.setProperty(TREEID_INPUT_MIDI_CHANNEL, this->channelFilter.getChannel(), nullptr);
+    tree.setProperty(TREEID_TRANSPOSE, this->transpose.getSemitones(), nullptr);
+    tree.setProperty(TREEID_VELOCITY_SCALING, this->velocityScaling, nullptr);
+    tree.setProperty(TREEID_DETERMINISTIC, this->deterministic, nullptr);
+}
+
+void ArpEngine::readState(ValueTree &tree) {
+    if (tree.hasProperty(TREEID_LOOP_RESET)) {
+        setLoopReset(tree.getProperty(TREEID_LOOP_RESET));
+    }
+
+    if (tree.hasProperty(TREEID_OCTAVES)) {
+        this->octaves = static_cast<bool>(tree.getProperty(TREEID_OCTAVES));
+    }
+
+    if (tree.hasProperty(TREEID_NUM_INPUT_NOTES)) {
+        this->numInputNotes = tree.getProperty(TREEID_NUM_INPUT_NOTES);
+    }
+
+    if (tree.hasProperty(TREEID_OUTPUT_MIDI_CHANNEL)) {
+        this->outputMidiChannel = tree.getProperty(TREEID_OUTPUT_MIDI_CHANNEL);
+    }
+
+    if (tree.hasProperty(TREEID_INPUT_MIDI_CHANNEL)) {
+        this->channelFilter.setChannel(tree.getProperty(TREEID_INPUT_MIDI_CHANNEL));
+    }
+
+    if (tree.hasProperty(TREEID_TRANSPOSE)) {
+        this->transpose.setSemitones(tree.getProperty(TREEID_TRANSPOSE));
+    }
+
+    if (tree.hasProperty(TREEID_VELOCITY_SCALING)) {
+        this->velocityScaling = tree.getProperty(TREEID_VELOCITY_SCALING);
+    }
+
+    if (tree.hasProperty(TREEID_DETERMINISTIC)) {
+        this->deterministic = tree.getProperty(TREEID_DETERMINISTIC);
+    }
+}
+
+
+void ArpEngine::setLoopReset(double loopReset) {
+    this->loopReset = jmax(0.0, loopReset);
+}
+
+double ArpEngine::getLoopReset() {
+    return this->loopReset;
+}
+
+void ArpEngine::setOctaves(bool octaves) {
+    this->octaves = octaves;
+}
+
+bool ArpEngine::getOctaves() {
+    return this->octaves;
+}
+
+int ArpEngine::getNumInputNotes() {
+    return this->numInputNotes;
+}
+
+int ArpEngine::getOutputMidiChannel() {
+    return this->outputMidiChannel;
+}
+
+void ArpEngine::setOutputMidiChannel(int channel) {
+    jassert(channel >= 1 && channel <= 16);
+    this->outputMidiChannel = channel;
+}
+
+int ArpEngine::getInputMidiChannel() {
+    return this->channelFilter.getChannel();
+}
+
+void ArpEngine::setInputMidiChannel(int channel) {
+    this->channelFilter.setChannel(channel);
+}
+
+int ArpEngine::getTranspose() {
+    return this->transpose.getSemitones();
+}
+
+void ArpEngine::setTranspose(int semitones) {
+    this->transpose.setSemitones(semitones);
+}
+
+bool ArpEngine::getVelocityScaling() {
+    return this->velocityScaling;
+}
+
+void ArpEngine::setVelocityScaling(bool velocityScaling) {
+    this->velocityScaling = velocityScaling;
+}
+
+bool ArpEngine::getDeterministic() {
+    return this->deterministic;
+}
+
+void ArpEngine::setDeterministic(bool deterministic) {
+    this->deterministic = deterministic;
+}
+
+
+const ArpPlaybackState::Snapshot &ArpEngine::getPlaybackSnapshot() {
+    return this->playbackState.read();
+}
+
+
+
+template <typename ConsumeCallback>
+void ArpEngine::processInputMidi(MidiBuffer &inMidi, ConsumeCallback &&onConsume) {
+    LIBREARP_AUDIO_THREAD_SCOPE("processInputMidi");
+
+    if (inMidi.isEmpty()) {
+        return;
+    }
+
+    inputFilter.process(inMidi, onConsume);
+}
+
+void ArpEngine::consumeInputNote(const ArpInputStage::Note &note) {
+    if (note.isNoteOn) {
+        inputNotes.add(note.note);
+    } else {
+        inputNotes.remove(note.note);
+    }
+}
+
+void ArpEngine::stopVoices() {
+    playbackChanged = true;
+    voices.stopAll(events->data, [&](int channel, int note) {
+        output.addNoteOff(channel, note, 0);
+    });
+}
+
+void ArpEngine::migrateVoices(ArpBuiltEvents &fresh) {
+    if (voices.getNumVoices() == 0) {
+        return;
+    }
+
+    // A changed timebase or loop length moves every note relative to the playhead, so nothing can be kept then
+    if (!scheduler.isValid() || fresh.timebase != events->timebase || fresh.loopLength != events->loopLength) {
+        stopVoices();
+        return;
+    }
+
+    playbackChanged = true;
+    auto patternTime = scheduler.getPatternTime();
+    voices.migrate(events->data, fresh.data,
+            [&](uint32 dataIndex, int, int) {
+                // The data of each note is built at the index of the note
+                auto &oldData = events->data[dataIndex];
+                auto newIndex = oldData.noteIndex;
+                if (newIndex >= fresh.data.size()
+                        || fresh.data[newIndex].noteNumber != oldData.noteNumber
+                        || !fresh.intervals.covers(static_cast<uint32>(newIndex), patternTime)) {
+                    return -1;
+                }
+                return static_cast<int>(newIndex);
+            },
+            [&](int channel, int note) {
+                output.addNoteOff(channel, note, 0);
+            });
+}
+
+void ArpEngine::processSegment(Window &window, int endOffset) {
+    window.from = window.to;
+    window.to = jmax(window.from, tempoMap.getFirstPulse(endOffset));
+
+    if (!inputNotes.isEmpty() && numInputNotes != inputNotes.size()) {
+        numInputNotes = inputNotes.size();
+        playbackChanged = true;
+    }
+
+    // The setting is read once, so that the whole segment is resolved and processed with the same one
+    auto isOctaves = octaves.load();
+    updateResolvedGeneration(isOctaves);
+
+    auto hasInputs = !inputNotes.isEmpty();
+
+    if (!hasInputs && voices.getNumVoices() == 0) {
+        // No event can start or stop a voice, the cursor is re-seeked once there is something to play. The notes
+        // already under way then are not chased, they start at their next onset as if the cursor had kept going.
+        scheduler.reset();
+        idle = true;
+    } else {
+        // The modes are constant for the whole segment, so each combination gets its own kernel
+        auto kernel = ((window.resetLength > 0) ? 4 : 0) | (isOctaves ? 2 : 0) | (hasInputs ? 1 : 0);
+        switch (kernel) {
+            case 0:
+                processWindow<false, false, false>(window);
+                break;
+            case 1:
+                processWindow<false, false, true>(window);
+                break;
+            case 2:
+                processWindow<false, true, false>(window);
+                break;
+            case 3:
+                processWindow<false, true, true>(window);
+                break;
+            case 4:
+                processWindow<true, false, false>(window);
+                break;
+            case 5:
+                processWindow<true, false, true>(window);
+                break;
+            case 6:
+                processWindow<true, true, false>(window);
+                break;
+            default:
+                processWindow<true, true, true>(window);
+                break;
+        }
+    }
+}
+
+template <bool Reset, bool Octaves, bool HasInputs>
+void ArpEngine::processWindow(const Window &window) {
+    auto offsetOf = [&](int64 time) {
+        return static_cast<int>(jlimit(static_cast<int64>(0), static_cast<int64>(window.numSamples - 1),
+                tempoMap.getOffset(time)));
+    };
+
+    scheduler.schedule<Reset>(*events, window.resetLength, window.from, window.to,
+            [&](size_t event, int64 time) {
+                processEvent<Octaves, HasInputs>(event, offsetOf(time));
+            },
+            [&](int64 time) {
+                processLoopStart(offsetOf(time));
+            },
+            [&](int64 patternTime, int64 time) {
+                if (!idle) {
+                    processChase<Octaves, HasInputs>(patternTime, offsetOf(time));
+                }
+            });
+    idle = false;
+}
+
+template <bool Octaves, bool HasInputs>
+void ArpEngine::processEvent(size_t event, int offset) {
+    playbackChanged = true;
+    auto noteOff = [&](int channel, int note) {
+        output.addNoteOff(channel, note, offset);
+    };
+
+    for (auto i : events->getOffs(event)) {
+        voices.stop(events->data, i, noteOff);
+    }
+
+    if (HasInputs) {
+        auto ons = events->getOns(event);
+        resolveOns<Octaves>(ons);
+        startNotes(ons, offset);
+    }
+}
+
+template <bool Octaves, bool HasInputs>
+void ArpEngine::processChase(int64 patternTime, int offset) {
+    if (!HasInputs) {
+        return;
+    }
+
+    uint32 batch[RESOLVE_BATCH_SIZE];
+    int count = 0;
+    auto flush = [&]() {
+        ArpBuiltEvents::IndexRange ons { batch, batch + count };
+        resolveNotes<Octaves>(ons);
+        startNotes(ons, offset);
+        count = 0;
+    };
+
+    events->intervals.findSounding(patternTime, [&](uint32 dataIndex) {
+        batch[count++] = dataIndex;
+        if (count == RESOLVE_BATCH_SIZE) {
+            flush();
+        }
+    });
+
+    if (count > 0) {
+        flush();
+    }
+}
+
+void ArpEngine::startNotes(ArpBuiltEvents::IndexRange ons, int offset) {
+    playbackChanged = true;
+    auto noteOff = [&](int channel, int note) {
+        output.addNoteOff(channel, note, offset);
+    };
+
+    for (auto i : ons) {
+        auto &data = events->data[i];
+        auto note = data.resolvedNote;
+        if (data.lastNote != note) {
+            voices.stop(events->data, i, noteOff);
+            if (voices.start(events->data, i, outputMidiChannel, note)) {
+                auto velocity = data.velocity;
+                if (velocityScaling) {
+                    auto inputNote = resolver.getInputNote(data.noteNumber);
+                    velocity *= velocityCapture.getVelocity(inputNote) / MAX_VELOCITY;
+                }
+                output.addNoteOn(outputMidiChannel, note, static_cast<float>(velocity), offset);
+            }
+        }
+    }
+}
+
+void ArpEngine::updateResolvedGeneration(bool isOctaves) {
+    if (inputNotes.getVersion() != resolvedInputVersion || isOctaves != resolvedOctaves) {
+        resolvedInputVersion = inputNotes.getVersion();
+        resolvedOctaves = isOctaves;
+        if (!inputNotes.isEmpty()) {
+            resolver.setChord(inputNotes.getSorted(), inputNotes.size());
+        }
+
+        // Zero marks note data that has never been resolved
+        if (++resolvedGeneration == 0) {
+            resolvedGeneration = 1;
+        }
+    }
+}
+
+template <bool Octaves>
+void ArpEngine::resolveOns(ArpBuiltEvents::IndexRange ons) {
+    if (ons.size() == 0 || events->data[*ons.first].resolvedGeneration == resolvedGeneration) {
+        return;
+    }
+
+    resolveNotes<Octaves>(ons);
+}
+
+template <bool Octaves>
+void ArpEngine::resolveNotes(ArpBuiltEvents::IndexRange ons) {
+    int noteNumbers[RESOLVE_BATCH_SIZE];
+    int resolvedNotes[RESOLVE_BATCH_SIZE];
+    for (auto first = ons.first; first < ons.last; first += RESOLVE_BATCH_SIZE) {
+        auto count = static_cast<int>(jmin<ptrdiff_t>(RESOLVE_BATCH_SIZE, ons.last - first));
+        for (int i = 0; i < count; i++) {
+            noteNumbers[i] = events->data[first[i]].noteNumber;
+        }
+
+        resolver.resolve(noteNumbers, resolvedNotes, count, Octaves);
+
+        for (int i = 0; i < count; i++) {
+            auto &data = events->data[first[i]];
+            data.resolvedNote = resolvedNotes[i];
+            data.resolvedGeneration = resolvedGeneration;
+        }
+    }
+}
+
+void ArpEngine::processLoopStart(int offset) {
+    playbackChanged = true;
+    voices.stopAll(events->data, [&](int channel, int note) {
+        output.addNoteOff(channel, note, offset);
+    });
+}
+
+void ArpEngine::publishPlaybackState() {
+    auto &snapshot = playbackState.getBack();
+    snapshot.position = lastPosition;
+    snapshot.numInputNotes = numInputNotes;
+    snapshot.timeSigNumerator = timeSigNumerator;
+    snapshot.timeSigDenominator = timeSigDenominator;
+
+    // The data of each note is built at the index of the note
+    snapshot.numPlayingNotes = voices.getDataIndices(snapshot.playingNoteIndices);
+    playbackState.publish();
+}
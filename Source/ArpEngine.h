@@ -0,0 +1,667 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <atomic>
+#include "JuceHeader.h"
+#include "ArpPattern.h"
+#include "ArpPatternCompiler.h"
+#include "ArpScheduler.h"
+#include "ArpInputNotes.h"
+#include "ArpNoteResolver.h"
+#include "ArpVoiceTable.h"
+#include "ArpPlaybackState.h"
+#include "ArpMidiOutput.h"
+#include "ArpTempoMap.h"
+#include "input/ArpInputFilter.h"
+#include "input/ArpChannelFilter.h"
+#include "input/ArpTranspose.h"
+#include "input/ArpVelocityCapture.h"
+
+/**
+ * The LibreArp playback engine.
+ *
+ * Turns input MIDI notes and the transport position into arpeggiated MIDI output, block by block. The engine does not
+ * depend on the plugin wrapper nor the editor, so it can be driven by the audio processor as well as by offline tools.
+ */
+class ArpEngine {
+public:
+    static const Identifier TREEID_LOOP_RESET;
+    static const Identifier TREEID_OCTAVES;
+    static const Identifier TREEID_NUM_INPUT_NOTES;
+    static const Identifier TREEID_OUTPUT_MIDI_CHANNEL;
+    static const Identifier TREEID_INPUT_MIDI_CHANNEL;
+    static const Identifier TREEID_TRANSPOSE;
+    static const Identifier TREEID_VELOCITY_SCALING;
+    static const Identifier TREEID_DETERMINISTIC;
+
+    /**
+     * The transport information the engine is driven by.
+     */
+    class Transport {
+    public:
+
+        /**
+         * The maximum number of tempo changes within a block.
+         */
+        static constexpr int MAX_TEMPO_CHANGES = ArpTempoMap::MAX_SEGMENTS - 1;
+
+        /**
+         * A change of the tempo within the block.
+         */
+        class TempoChange {
+        public:
+
+            /**
+             * The sample offset within the block the tempo changes at.
+             */
+            int sample = 0;
+
+            /**
+             * The tempo from the sample offset on, in beats per minute.
+             */
+            double bpm = 120.0;
+        };
+
+
+
+        /**
+         * Whether the transport is playing.
+         */
+        bool isPlaying = false;
+
+        /**
+         * The tempo at the start of the block in beats per minute.
+         */
+        double bpm = 120.0;
+
+        /**
+         * The tempo changes within the block, in ascending order of their sample offsets. Changes outside of the
+         * block or at its first sample are ignored.
+         */
+        TempoChange tempoChanges[MAX_TEMPO_CHANGES];
+
+        /**
+         * The number of valid entries in tempoChanges.
+         */
+        int numTempoChanges = 0;
+
+        /**
+         * The position of the start of the block in quarter notes.
+         */
+        double ppqPosition = 0.0;
+
+        /**
+         * The time signature numerator.
+         */
+        int timeSigNumerator = 4;
+
+        /**
+         * The time signature denominator.
+         */
+        int timeSigDenominator = 4;
+    };
+
+
+
+    /**
+     * Constructs the engine with an empty pattern.
+     */
+    ArpEngine();
+
+    /**
+     * Deletes the events in use.
+     */
+    ~ArpEngine();
+
+
+
+    /**
+     * Prepares the engine for processing.
+     *
+     * @param sampleRate the sample rate
+     * @param maxBlockSize the maximum number of samples in a block
+     */
+    void prepare(double sampleRate, int maxBlockSize);
+
+    /**
+     * Processes a block. Input note messages are consumed, all other messages are passed through and the generated
+     * notes are added.
+     *
+     * @param transport the transport information at the start of the block
+     * @param numSamples the number of samples in the block
+     * @param midi the MIDI messages of the block
+     * @param nonRealtime whether the block is processed offline, in which case the engine waits for scheduled pattern
+     * builds to finish
+     */
+    void process(const Transport &transport, int numSamples, MidiBuffer &midi, bool nonRealtime);
+
+    /**
+     * Schedules a stop of all currently playing notes. The stop will occur on the next block process.
+     */
+    void stopAll();
+
+    /**
+     * Schedules a build of a copy of the specified pattern. Must be called from the thread that edits the pattern.
+     *
+     * @param pattern the pattern to build
+     */
+    void compile(ArpPattern &pattern);
+
+    /**
+     * Schedules a build of the specified pattern, shared with the compiler rather than copied.
+     *
+     * @param pattern the pattern to build, which must not be modified anymore
+     */
+    void compile(std::shared_ptr<const ArpPattern> pattern);
+
+    /**
+     * Schedules a build of the specified pattern, in which only the specified notes have changed since the last
+     * scheduled build, so that the built events can be updated in place. The pattern is shared with the compiler
+     * rather than copied.
+     *
+     * @param pattern the pattern to build, which must not be modified anymore
+     * @param changedNotes the indices of the notes that have changed
+     */
+    void compile(std::shared_ptr<const ArpPattern> pattern, const std::vector<uint64> &changedNotes);
+
+    /**
+     * Has the compiler delete the built events the audio thread has stopped using, if there are any. Meant to be
+     * polled from the message thread.
+     */
+    void reclaimEvents();
+
+
+
+    /**
+     * Writes the persistent settings of the engine into the specified tree.
+     *
+     * @param tree the tree to write the settings into
+     */
+    void writeState(ValueTree &tree);
+
+    /**
+     * Reads the persistent settings of the engine present in the specified tree.
+     *
+     * @param tree the tree to read the settings from
+     */
+    void readState(ValueTree &tree);
+
+
+
+    /**
+     * Sets the amount of beats after which the loop should reset.
+     *
+     * @param loopReset the amount of beats after which the loop should reset
+     */
+    void setLoopReset(double loopReset);
+
+    /**
+     * Gets the amount of beats after which the loop should reset.
+     *
+     * @return the amount of beats after which the loop should reset
+     */
+    double getLoopReset();
+
+    /**
+     * Sets whether the engine should transpose octaves upon "note overflow".
+     *
+     * @param octaves whether the engine should transpose octaves upon "note overflow"
+     */
+    void setOctaves(bool octaves);
+
+    /**
+     * Gets whether the engine transposes octaves upon "note overflow".
+     *
+     * @return whether the engine transposes octaves upon "note overflow"
+     */
+    bool getOctaves();
+
+    /**
+     * Gets the last active number of input notes.
+     *
+     * @return the last active number of input notes
+     */
+    int getNumInputNotes();
+
+    /**
+     * Gets the MIDI channel output notes are sent into.
+     *
+     * @return the MIDI channel output notes are sent into
+     */
+    int getOutputMidiChannel();
+
+    /**
+     * Sets the MIDI channel output notes are sent into.
+     *
+     * @param channel the MIDI channel output notes are sent into. An integer from range 1-16.
+     */
+    void setOutputMidiChannel(int channel);
+
+    /**
+     * Gets the MIDI channel input notes are read from.
+     *
+     * @return the MIDI channel input notes are read from
+     */
+    int getInputMidiChannel();
+
+    /**
+     * Sets the MIDI channel input notes are read from.
+     *
+     * @param channel the MIDI channel input notes are read from. An integer from range 0-16. Notes from all channels
+     * are read if zero.
+     */
+    void setInputMidiChannel(int channel);
+
+    /**
+     * Gets the number of semitones the input notes are transposed by.
+     *
+     * @return the number of semitones the input notes are transposed by
+     */
+    int getTranspose();
+
+    /**
+     * Sets the number of semitones the input notes are transposed by. Input notes transposed out of the MIDI range are
+     * ignored.
+     *
+     * @param semitones the number of semitones the input notes are transposed by, negative to transpose down
+     */
+    void setTranspose(int semitones);
+
+    /**
+     * Gets whether the velocity of the pattern notes is scaled by the velocity the input notes are played with.
+     *
+     * @return whether the velocity of the pattern notes is scaled by the played velocity
+     */
+    bool getVelocityScaling();
+
+    /**
+     * Sets whether the velocity of the pattern notes is scaled by the velocity the input notes are played with.
+     *
+     * @param velocityScaling whether the velocity of the pattern notes is scaled by the played velocity
+     */
+    void setVelocityScaling(bool velocityScaling);
+
+    /**
+     * Gets whether the output is independent of how the host splits the playback into blocks.
+     *
+     * @return whether the output is independent of the block sizes
+     */
+    bool getDeterministic();
+
+    /**
+     * Sets whether the output is independent of how the host splits the playback into blocks. In deterministic mode,
+     * the events are timed by a sample clock anchored where the playback starts instead of the position reported for
+     * each block, and input notes take effect at their exact sample instead of at the start of their block.
+     *
+     * @param deterministic whether the output is independent of the block sizes
+     */
+    void setDeterministic(bool deterministic);
+
+
+
+    /**
+     * Gets the most recent snapshot of the playback state. To be called from a single reader thread only; the
+     * snapshot stays valid until the next call.
+     *
+     * @return the most recent snapshot of the playback state
+     */
+    const ArpPlaybackState::Snapshot &getPlaybackSnapshot();
+
+private:
+
+    /**
+     * The playback window of a block, or of a segment of it. The sample offsets of its pulses are given by the tempo
+     * map of the block.
+     */
+    class Window {
+    public:
+
+        /**
+         * The amount of pulses after which the pattern restarts, zero for no reset.
+         */
+        int64 resetLength;
+
+        /**
+         * The first pulse of the window (inclusive).
+         */
+        int64 from;
+
+        /**
+         * The first pulse after the window (exclusive).
+         */
+        int64 to;
+
+        /**
+         * The number of samples in the block.
+         */
+        int numSamples;
+    };
+
+
+
+    /**
+     * The pattern built for playback. Owned by the audio thread, replaced through the compiler.
+     */
+    ArpBuiltEvents *events;
+
+    /**
+     * The background compiler of the pattern.
+     */
+    ArpPatternCompiler compiler;
+
+    /**
+     * The scheduler of the built events.
+     */
+    ArpScheduler scheduler;
+
+
+
+    /**
+     * The tempo map of the current block. Also holds the sample rate the engine has been prepared with.
+     */
+    ArpTempoMap tempoMap;
+
+    /**
+     * Whether the engine should transpose octaves upon "note overflow". Also written by readState, which may run on
+     * another thread than processing.
+     */
+    std::atomic<bool> octaves;
+
+    /**
+     * The amount of beats after which the loop should reset.
+     */
+    double loopReset;
+
+    /**
+     * The MIDI channel output notes are sent to.
+     */
+    int outputMidiChannel;
+
+    /**
+     * Whether the velocity of the pattern notes is scaled by the velocity the input notes are played with.
+     */
+    bool velocityScaling;
+
+    /**
+     * Whether the output is independent of how the host splits the playback into blocks.
+     */
+    bool deterministic;
+
+
+
+    /**
+     * The last position the engine has played, in pulses.
+     */
+    int64 lastPosition;
+
+    /**
+     * The position of the end of the last block, in fractional pulses.
+     */
+    double lastEndPulse;
+
+    /**
+     * The end of the window of the last block, in pulses.
+     */
+    int64 lastWindowEnd;
+
+    /**
+     * The number of samples processed since the engine was created.
+     */
+    int64 sampleClock;
+
+    /**
+     * The sample clock value the deterministic timing is anchored at.
+     */
+    int64 anchorSample;
+
+    /**
+     * The position the deterministic timing is anchored at, in fractional pulses.
+     */
+    double anchorPulse;
+
+    /**
+     * The number of samples per pulse the deterministic timing has been anchored with.
+     */
+    double anchorPulseSamples;
+
+    /**
+     * Whether the transport was playing in the last block.
+     */
+    bool wasPlaying;
+
+    /**
+     * Whether stopAll was called.
+     */
+    bool stopScheduled;
+
+    /**
+     * Whether the last segment had nothing to play, so that the cursor has been dropped without chasing.
+     */
+    bool idle;
+
+
+
+    /**
+     * The set of currently fed input notes.
+     */
+    ArpInputNotes inputNotes;
+
+    /**
+     * The resolver of pattern note numbers against the input notes.
+     */
+    ArpNoteResolver resolver;
+
+    /**
+     * The voices of the pattern currently playing.
+     */
+    ArpVoiceTable voices;
+
+    /**
+     * The input stage reading notes from the input MIDI channel only.
+     */
+    ArpChannelFilter channelFilter;
+
+    /**
+     * The input stage transposing the input notes.
+     */
+    ArpTranspose transpose;
+
+    /**
+     * The input stage recording the velocity of the input notes.
+     */
+    ArpVelocityCapture velocityCapture;
+
+    /**
+     * The input filter pipeline, made of the input stages.
+     */
+    ArpInputFilter inputFilter;
+
+    /**
+     * The output stage the generated notes are merged into the MIDI buffer through.
+     */
+    ArpMidiOutput output;
+
+    /**
+     * The last active number of input notes.
+     */
+    int numInputNotes;
+
+    /**
+     * The generation of the resolved notes cached in the note data. Changes whenever the input notes or the octaves
+     * setting change; never zero.
+     */
+    uint32 resolvedGeneration;
+
+    /**
+     * The version of the input notes the resolved notes have been computed for.
+     */
+    uint32 resolvedInputVersion;
+
+    /**
+     * The octaves setting the resolved notes have been computed for.
+     */
+    bool resolvedOctaves;
+
+    /**
+     * Time signature numerator.
+     */
+    int timeSigNumerator;
+
+    /**
+     * Time signature denominator.
+     */
+    int timeSigDenominator;
+
+
+
+    /**
+     * The playback state shared with the editor.
+     */
+    ArpPlaybackState playbackState;
+
+    /**
+     * Whether the playback state has changed since it was last published.
+     */
+    bool playbackChanged;
+
+
+
+    /**
+     * Processes input MIDI messages.
+     *
+     * @param inMidi the input MIDI messages
+     * @param onConsume the function called as onConsume(sample, note) for every input note message, in time order
+     */
+    template <typename ConsumeCallback>
+    void processInputMidi(MidiBuffer &inMidi, ConsumeCallback &&onConsume);
+
+    /**
+     * Adds or removes an input note.
+     *
+     * @param note the input note message
+     */
+    void consumeInputNote(const ArpInputStage::Note &note);
+
+    /**
+     * Sends a noteOff for all currently playing output notes at the start of the block.
+     */
+    void stopVoices();
+
+    /**
+     * Moves the playing voices over to the note data of newly built events, so that editing the pattern does not cut
+     * the notes that are sounding. A voice is kept by the note at the same index in the new pattern, as long as it
+     * plays the same note number and still sounds at the current position; all the other voices are stopped at the
+     * start of the block.
+     *
+     * @param fresh the newly built events, not in use yet
+     */
+    void migrateVoices(ArpBuiltEvents &fresh);
+
+    /**
+     * Advances the window to the specified sample offset and processes it.
+     *
+     * @param window the playback window, whose end is moved to the first pulse at or after the offset
+     * @param endOffset the sample offset of the end of the segment within the block
+     */
+    void processSegment(Window &window, int endOffset);
+
+    /**
+     * Schedules and sends the events due in the playback window.
+     *
+     * @tparam Reset whether the pattern restarts after the reset length
+     * @tparam Octaves whether octaves are transposed upon "note overflow"
+     * @tparam HasInputs whether there are input notes, without which no voice can start
+     * @param window the playback window
+     */
+    template <bool Reset, bool Octaves, bool HasInputs>
+    void processWindow(const Window &window);
+
+    /**
+     * Sends the note offs and note ons of the specified event.
+     *
+     * @tparam Octaves whether octaves are transposed upon "note overflow"
+     * @tparam HasInputs whether there are input notes, without which no voice can start
+     * @param event the index of the event to process
+     * @param offset the sample offset of the event in the current block
+     */
+    template <bool Octaves, bool HasInputs>
+    void processEvent(size_t event, int offset);
+
+    /**
+     * Starts the notes that should already be sounding when playback starts in the middle of a loop iteration, as if
+     * they had been played from their start.
+     *
+     * @tparam Octaves whether octaves are transposed upon "note overflow"
+     * @tparam HasInputs whether there are input notes, without which no voice can start
+     * @param patternTime the position within the loop iteration, in pulses
+     * @param offset the sample offset of the position in the current block
+     */
+    template <bool Octaves, bool HasInputs>
+    void processChase(int64 patternTime, int offset);
+
+    /**
+     * Starts the voices of the specified notes whose resolved MIDI note is not playing yet.
+     *
+     * @param ons the indices of the note data of the notes, all resolved with the current generation
+     * @param offset the sample offset of the note ons in the current block
+     */
+    void startNotes(ArpBuiltEvents::IndexRange ons, int offset);
+
+    /**
+     * Invalidates the resolved notes cached in the note data and updates the resolver if the input notes or the
+     * octaves setting have changed.
+     *
+     * @param isOctaves the octaves setting the segment is processed with
+     */
+    void updateResolvedGeneration(bool isOctaves);
+
+    /**
+     * Resolves the output MIDI note numbers of the note ons of an event in batches and caches them in the note data
+     * until the next change of the input notes or the octaves setting. The note ons of an event are always resolved
+     * together, so the event is skipped if its first note on is already cached.
+     *
+     * @tparam Octaves whether octaves are transposed upon "note overflow"
+     * @param ons the indices of the note data of the note ons. The input notes must not be empty.
+     */
+    template <bool Octaves>
+    void resolveOns(ArpBuiltEvents::IndexRange ons);
+
+    /**
+     * Resolves the output MIDI note numbers of the specified notes in batches and caches them in the note data.
+     *
+     * @tparam Octaves whether octaves are transposed upon "note overflow"
+     * @param ons the indices of the note data of the notes. The input notes must not be empty.
+     */
+    template <bool Octaves>
+    void resolveNotes(ArpBuiltEvents::IndexRange ons);
+
+    /**
+     * Sends a noteOff for all currently playing pattern notes, as the loop starts over.
+     *
+     * @param offset the sample offset of the loop start in the current block
+     */
+    void processLoopStart(int offset);
+
+    /**
+     * Publishes the current playback state to the editor.
+     */
+    void publishPlaybackState();
+
+    JUCE_DECLARE_NON_COPYABLE(ArpEngine);
+};
@@ -0,0 +1,100 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "ArpInputNotes.h"
+
+ArpInputNotes::ArpInputNotes() {
+    this->version = 0;
+    clear();
+}
+
+
+void ArpInputNotes::add(int note) {
+    jassert(note >= 0 && note < NUM_NOTES);
+    auto mask = uint64(1) << (note % 64);
+    auto &word = this->bits[note / 64];
+    if ((word & mask) == 0) {
+        word |= mask;
+        this->numNotes++;
+        this->sortedDirty = true;
+        this->version++;
+    }
+}
+
+void ArpInputNotes::remove(int note) {
+    jassert(note >= 0 && note < NUM_NOTES);
+    auto mask = uint64(1) << (note % 64);
+    auto &word = this->bits[note / 64];
+    if ((word & mask) != 0) {
+        word &= ~mask;
+        this->numNotes--;
+        this->sortedDirty = true;
+        this->version++;
+    }
+}
+
+void ArpInputNotes::clear() {
+    for (auto &word : this->bits) {
+        word = 0;
+    }
+    this->numNotes = 0;
+    this->sortedDirty = true;
+    this->version++;
+}
+
+
+int ArpInputNotes::size() const {
+    return this->numNotes;
+}
+
+bool ArpInputNotes::isEmpty() const {
+    return this->numNotes == 0;
+}
+
+bool ArpInputNotes::contains(int note) const {
+    return (this->bits[note / 64] & (uint64(1) << (note % 64))) != 0;
+}
+
+int ArpInputNotes::operator[](int index) {
+    jassert(index >= 0 && index < this->numNotes);
+    if (this->sortedDirty) {
+        updateSorted();
+    }
+    return this->sorted[index];
+}
+
+const int *ArpInputNotes::getSorted() {
+    if (this->sortedDirty) {
+        updateSorted();
+    }
+    return this->sorted;
+}
+
+uint32 ArpInputNotes::getVersion() const {
+    return this->version;
+}
+
+
+void ArpInputNotes::updateSorted() {
+    int count = 0;
+    for (int note = 0; note < NUM_NOTES; note++) {
+        if (contains(note)) {
+            this->sorted[count++] = note;
+        }
+    }
+    this->sortedDirty = false;
+}
@@ -0,0 +1,135 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include "JuceHeader.h"
+
+/**
+ * A fixed-size set of the MIDI notes currently fed into the processor.
+ *
+ * Notes are stored in a 128-bit bitmap, so adding and removing them is O(1) and never allocates. The sorted view of the
+ * notes the arpeggiator indexes into is cached and only rebuilt after the set has changed.
+ */
+class ArpInputNotes {
+public:
+    static constexpr int NUM_NOTES = 128;
+
+    /**
+     * Constructs an empty set.
+     */
+    ArpInputNotes();
+
+
+
+    /**
+     * Adds the note to the set.
+     *
+     * @param note the MIDI note number
+     */
+    void add(int note);
+
+    /**
+     * Removes the note from the set.
+     *
+     * @param note the MIDI note number
+     */
+    void remove(int note);
+
+    /**
+     * Removes all the notes from the set.
+     */
+    void clear();
+
+
+
+    /**
+     * Gets the number of notes in the set.
+     *
+     * @return the number of notes in the set
+     */
+    int size() const;
+
+    /**
+     * Checks whether the set is empty.
+     *
+     * @return true if there are no notes in the set
+     */
+    bool isEmpty() const;
+
+    /**
+     * Checks whether the note is in the set.
+     *
+     * @param note the MIDI note number
+     * @return true if the note is in the set
+     */
+    bool contains(int note) const;
+
+    /**
+     * Gets the note at the specified index in ascending order.
+     *
+     * @param index the index of the note, from zero to size() - 1
+     * @return the MIDI note number
+     */
+    int operator[](int index);
+
+    /**
+     * Gets the notes of the set as a flat array in ascending order. The array stays valid until the set is modified.
+     *
+     * @return the array of size() MIDI note numbers
+     */
+    const int *getSorted();
+
+    /**
+     * Gets the version of the set, which changes every time notes are added or removed.
+     *
+     * @return the version of the set
+     */
+    uint32 getVersion() const;
+
+private:
+
+    /**
+     * The bitmap of notes in the set.
+     */
+    uint64 bits[NUM_NOTES / 64];
+
+    /**
+     * The number of notes in the set.
+     */
+    int numNotes;
+
+    /**
+     * The cached notes of the set in ascending order.
+     */
+    int sorted[NUM_NOTES];
+
+    /**
+     * Whether the set has changed since the sorted view was last built.
+     */
+    bool sortedDirty;
+
+    /**
+     * The version of the set, incremented on every change.
+     */
+    uint32 version;
+
+    /**
+     * Rebuilds the sorted view of the notes.
+     */
+    void updateSorted();
+};
@@ -0,0 +1,104 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+#include "ArpIntervalIndex.h"
+
+ArpIntervalIndex::ArpIntervalIndex() {
+    this->rootLevel = -1;
+}
+
+
+void ArpIntervalIndex::add(int64 start, int64 end, uint32 dataIndex) {
+    this->intervals.push_back(Interval { start, end, end, dataIndex });
+}
+
+void ArpIntervalIndex::build() {
+    std::sort(this->intervals.begin(), this->intervals.end(), isBefore);
+    link();
+}
+
+void ArpIntervalIndex::replace(uint32 dataIndex, int64 oldStart, int64 start, int64 end) {
+    Interval old { oldStart, 0, 0, dataIndex };
+    auto oldIt = std::lower_bound(this->intervals.begin(), this->intervals.end(), old, isBefore);
+    jassert(oldIt != this->intervals.end() && oldIt->dataIndex == dataIndex);
+    this->intervals.erase(oldIt);
+
+    Interval interval { start, end, end, dataIndex };
+    auto it = std::lower_bound(this->intervals.begin(), this->intervals.end(), interval, isBefore);
+    this->intervals.insert(it, interval);
+}
+
+void ArpIntervalIndex::link() {
+    auto numIntervals = this->intervals.size();
+    this->positions.clear();
+    for (size_t i = 0; i < numIntervals; i++) {
+        auto dataIndex = this->intervals[i].dataIndex;
+        if (dataIndex >= this->positions.size()) {
+            this->positions.resize(dataIndex + 1, static_cast<uint32>(numIntervals));
+        }
+        this->positions[dataIndex] = static_cast<uint32>(i);
+    }
+
+    if (numIntervals == 0) {
+        this->rootLevel = -1;
+        return;
+    }
+
+    // The leaves are the even indices. The last leaf stands in for the maximum end of the missing nodes on the right
+    // edge of the tree, and is carried up level by level.
+    size_t lastIndex = 0;
+    int64 lastMaxEnd = 0;
+    for (size_t i = 0; i < numIntervals; i += 2) {
+        lastIndex = i;
+        lastMaxEnd = this->intervals[i].maxEnd = this->intervals[i].end;
+    }
+
+    int level = 1;
+    for (; (size_t(1) << level) <= numIntervals; level++) {
+        auto half = size_t(1) << (level - 1);
+        for (auto i = (half << 1) - 1; i < numIntervals; i += half << 2) {
+            auto leftMaxEnd = this->intervals[i - half].maxEnd;
+            auto rightMaxEnd = (i + half < numIntervals) ? this->intervals[i + half].maxEnd : lastMaxEnd;
+            this->intervals[i].maxEnd = jmax(this->intervals[i].end, leftMaxEnd, rightMaxEnd);
+        }
+
+        lastIndex = ((lastIndex >> level) & 1) ? lastIndex - half : lastIndex + half;
+        if (lastIndex < numIntervals && this->intervals[lastIndex].maxEnd > lastMaxEnd) {
+            lastMaxEnd = this->intervals[lastIndex].maxEnd;
+        }
+    }
+    this->rootLevel = level - 1;
+}
+
+size_t ArpIntervalIndex::size() const {
+    return this->intervals.size();
+}
+
+bool ArpIntervalIndex::covers(uint32 dataIndex, int64 time) const {
+    if (dataIndex >= this->positions.size() || this->positions[dataIndex] >= this->intervals.size()) {
+        return false;
+    }
+
+    auto &interval = this->intervals[this->positions[dataIndex]];
+    return interval.start <= time && time < interval.end;
+}
+
+
+bool ArpIntervalIndex::isBefore(const Interval &a, const Interval &b) {
+    return (a.start != b.start) ? a.start < b.start : a.dataIndex < b.dataIndex;
+}
@@ -0,0 +1,223 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <vector>
+#include "JuceHeader.h"
+
+/**
+ * An index of the time intervals the notes of a pattern sound in, answering which notes sound at a given time.
+ *
+ * The intervals are sorted by their start and laid out as an implicit binary search tree over the sorted array: the
+ * nodes of level k are the indices with exactly k trailing one bits, and each node holds the maximum end of its
+ * subtree. A query walks down from the root, skipping the subtrees that end before the queried time and stopping at
+ * the intervals that start after it, so it takes O(log n + k) for k sounding notes.
+ */
+class ArpIntervalIndex {
+public:
+
+    /**
+     * The time interval a note sounds in.
+     */
+    class Interval {
+    public:
+
+        /**
+         * The start of the interval in pulses (inclusive).
+         */
+        int64 start;
+
+        /**
+         * The end of the interval in pulses (exclusive).
+         */
+        int64 end;
+
+        /**
+         * The maximum end of the intervals in the subtree of the interval.
+         */
+        int64 maxEnd;
+
+        /**
+         * The index of the note data of the note.
+         */
+        uint32 dataIndex;
+    };
+
+
+
+    /**
+     * Constructs an empty index.
+     */
+    ArpIntervalIndex();
+
+
+
+    /**
+     * Adds an interval. The index has to be rebuilt before it is queried again.
+     *
+     * @param start the start of the interval in pulses (inclusive)
+     * @param end the end of the interval in pulses (exclusive)
+     * @param dataIndex the index of the note data of the note
+     */
+    void add(int64 start, int64 end, uint32 dataIndex);
+
+    /**
+     * Sorts the intervals and links them into the tree.
+     */
+    void build();
+
+    /**
+     * Replaces the interval of a note, keeping the intervals sorted. The index has to be relinked before it is queried
+     * again.
+     *
+     * @param dataIndex the index of the note data of the note
+     * @param oldStart the start of the current interval of the note in pulses
+     * @param start the new start of the interval in pulses (inclusive)
+     * @param end the new end of the interval in pulses (exclusive)
+     */
+    void replace(uint32 dataIndex, int64 oldStart, int64 start, int64 end);
+
+    /**
+     * Computes the positions of the intervals and the maximum ends of the subtrees, in linear time.
+     */
+    void link();
+
+    /**
+     * Gets the number of intervals.
+     *
+     * @return the number of intervals
+     */
+    size_t size() const;
+
+    /**
+     * Checks whether the interval of the specified note contains the specified time.
+     *
+     * @param dataIndex the index of the note data of the note
+     * @param time the time in pulses
+     * @return true if the note sounds at the time
+     */
+    bool covers(uint32 dataIndex, int64 time) const;
+
+    /**
+     * Calls the callback for each interval strictly containing the specified time, that is, for each note started
+     * before the time and ending after it.
+     *
+     * @param time the time in pulses
+     * @param onSounding the function called as onSounding(dataIndex) for every such interval
+     */
+    template <typename SoundingCallback>
+    void findSounding(int64 time, SoundingCallback &&onSounding) const;
+
+private:
+
+    /**
+     * The level up to which the subtrees are scanned linearly instead of walked.
+     */
+    static constexpr int LINEAR_SCAN_LEVEL = 3;
+
+    /**
+     * The capacity of the stack of a query, enough for a tree over any 32-bit amount of intervals.
+     */
+    static constexpr int MAX_DEPTH = 128;
+
+    /**
+     * A node of the tree waiting to be visited by a query.
+     */
+    class Node {
+    public:
+
+        /**
+         * The index of the node.
+         */
+        size_t index;
+
+        /**
+         * The level of the node.
+         */
+        int level;
+
+        /**
+         * Whether the left subtree of the node has already been queued.
+         */
+        bool leftQueued;
+    };
+
+
+
+    /**
+     * The intervals, sorted by their start.
+     */
+    std::vector<Interval> intervals;
+
+    /**
+     * The positions of the intervals of the notes in intervals, by the index of their note data. Entries of note data
+     * without an interval are out of range.
+     */
+    std::vector<uint32> positions;
+
+    /**
+     * The level of the root of the tree, -1 if the index is empty.
+     */
+    int rootLevel;
+
+
+
+    /**
+     * Orders intervals by their start, then by the index of their note data.
+     */
+    static bool isBefore(const Interval &a, const Interval &b);
+};
+
+
+
+template <typename SoundingCallback>
+void ArpIntervalIndex::findSounding(int64 time, SoundingCallback &&onSounding) const {
+    if (this->rootLevel < 0) {
+        return;
+    }
+
+    auto numIntervals = this->intervals.size();
+    Node stack[MAX_DEPTH];
+    int depth = 0;
+    stack[depth++] = Node { (size_t(1) << this->rootLevel) - 1, this->rootLevel, false };
+
+    while (depth > 0) {
+        auto node = stack[--depth];
+        if (node.level <= LINEAR_SCAN_LEVEL) {
+            auto first = node.index >> node.level << node.level;
+            auto last = jmin(first + (size_t(2) << node.level) - 1, numIntervals);
+            for (auto i = first; i < last && this->intervals[i].start < time; i++) {
+                if (time < this->intervals[i].end) {
+                    onSounding(this->intervals[i].dataIndex);
+                }
+            }
+        } else if (!node.leftQueued) {
+            // The left subtree is visited first, the node itself and its right subtree after it
+            auto left = node.index - (size_t(1) << (node.level - 1));
+            stack[depth++] = Node { node.index, node.level, true };
+            if (left >= numIntervals || this->intervals[left].maxEnd > time) {
+                stack[depth++] = Node { left, node.level - 1, false };
+            }
+        } else if (node.index < numIntervals && this->intervals[node.index].start < time) {
+            if (time < this->intervals[node.index].end) {
+                onSounding(this->intervals[node.index].dataIndex);
+            }
+            stack[depth++] = Node { node.index + (size_t(1) << (node.level - 1)), node.level - 1, false };
+        }
+    }
+}
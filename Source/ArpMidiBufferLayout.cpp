@@ -0,0 +1,39 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "ArpMidiBufferLayout.h"
+
+bool ArpMidiBufferLayout::check() {
+    const uint8 message[] = { 0x90, 60, 100 };
+    MidiBuffer midi;
+    midi.addEvent(message, 3, 42);
+
+    midi.addEvent(message, 3, 43);
+
+    auto &data = getData(midi);
+    auto isLayout = data.size() == (HEADER_SIZE + 3) * 2
+            && getTime(data.begin()) == 42
+            && getTotalSize(data.begin()) == HEADER_SIZE + 3
+            && std::memcmp(data.begin() + HEADER_SIZE, message, 3) == 0;
+
+    auto storage = data.getRawDataPointer();
+    truncate(midi, HEADER_SIZE + 3);
+    return isLayout
+            && data.getRawDataPointer() == storage
+            && data.size() == HEADER_SIZE + 3
+            && getTime(data.begin()) == 42;
+}
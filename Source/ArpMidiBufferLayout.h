@@ -0,0 +1,118 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <cstring>
+#include "JuceHeader.h"
+
+// The layout below is the one of JUCE 5.3, which the project is pinned to. Check it again when upgrading JUCE.
+static_assert(JUCE_MAJOR_VERSION == 5 && JUCE_MINOR_VERSION == 3, "The MidiBuffer layout is only known for JUCE 5.3");
+
+/**
+ * Raw access to the data of a MidiBuffer.
+ *
+ * Adding a message to a MidiBuffer scans the buffer for its place, so merging many messages through its interface is
+ * quadratic. The output stage merges them and the input filter removes them in a linear pass over the raw data
+ * instead, which relies on the internal layout of MidiBuffer::data: each message is stored as its int32 sample
+ * position, its uint16 size, then its bytes, in time order. All the code depending on that layout is kept here.
+ */
+class ArpMidiBufferLayout {
+public:
+
+    /**
+     * The size of the header stored before the bytes of each message.
+     */
+    static constexpr int HEADER_SIZE = sizeof(int32) + sizeof(uint16);
+
+    /**
+     * Checks that a MidiBuffer actually stores its messages in the expected layout, and that truncating it keeps its
+     * storage.
+     *
+     * @return true if the layout and truncation are as expected
+     */
+    static bool check();
+
+
+
+    /**
+     * Gets the raw data of a MidiBuffer.
+     *
+     * @param midi the MIDI buffer
+     * @return the messages of the buffer in the raw layout
+     */
+    static Array<uint8> &getData(MidiBuffer &midi) {
+        return midi.data;
+    }
+
+    /**
+     * Reads the sample position of a stored message.
+     *
+     * @param event the start of the stored message
+     * @return the sample position of the message
+     */
+    static int32 getTime(const uint8 *event) {
+        int32 time;
+        std::memcpy(&time, event, sizeof(int32));
+        return time;
+    }
+
+    /**
+     * Reads the total size of a stored message, header included.
+     *
+     * @param event the start of the stored message
+     * @return the number of bytes the message takes in the data
+     */
+    static int getTotalSize(const uint8 *event) {
+        uint16 size;
+        std::memcpy(&size, event + sizeof(int32), sizeof(uint16));
+        return HEADER_SIZE + size;
+    }
+
+    /**
+     * Stores a message.
+     *
+     * @param out the start of the stored message, with room for the header and the message bytes
+     * @param time the sample position of the message
+     * @param bytes the bytes of the message
+     * @param size the number of bytes of the message
+     * @return the end of the stored message
+     */
+    static uint8 *write(uint8 *out, int32 time, const uint8 *bytes, int size) {
+        auto size16 = static_cast<uint16>(size);
+        std::memcpy(out, &time, sizeof(int32));
+        std::memcpy(out + sizeof(int32), &size16, sizeof(uint16));
+        std::memcpy(out + HEADER_SIZE, bytes, static_cast<size_t>(size));
+        return out + HEADER_SIZE + size;
+    }
+
+    /**
+     * Truncates the raw data of a MidiBuffer to the messages stored before the specified size.
+     *
+     * Removing elements from an Array shrinks its storage, which reallocates. Clearing it keeps the storage instead,
+     * and adding the kept bytes back copies each one onto itself without reallocating, as they fit in it.
+     *
+     * @param midi the MIDI buffer
+     * @param size the number of bytes to keep, which must end at a message boundary
+     */
+    static void truncate(MidiBuffer &midi, int size) {
+        auto &data = getData(midi);
+        auto bytes = data.getRawDataPointer();
+        data.clearQuick();
+        data.addArray(bytes, size);
+    }
+};
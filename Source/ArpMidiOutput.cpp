@@ -0,0 +1,131 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+#include "ArpMidiOutput.h"
+#include "ArpMidiBufferLayout.h"
+
+const uint32 KIND_NOTE_OFF = 0;
+const uint32 KIND_NOTE_ON = 1;
+const int KIND_SHIFT = 24;
+
+const int NOTE_MESSAGE_SIZE = 3;
+const int NOTE_EVENT_SIZE = ArpMidiBufferLayout::HEADER_SIZE + NOTE_MESSAGE_SIZE; // Size of a note in MidiBuffer
+
+ArpMidiOutput::ArpMidiOutput(int capacity) : events(static_cast<size_t>(capacity)) {
+    jassert(capacity > 0 && capacity < (1 << KIND_SHIFT));
+    this->numEvents = 0;
+    this->target = nullptr;
+    for (auto &channel : this->noteOnGenerations) {
+        for (auto &noteGeneration : channel) {
+            noteGeneration = 0;
+        }
+    }
+    this->generation = 1;
+}
+
+
+void ArpMidiOutput::prepare(int maxBufferBytes) {
+    jassert(ArpMidiBufferLayout::check());
+    this->merged.ensureStorageAllocated(maxBufferBytes + static_cast<int>(this->events.size()) * NOTE_EVENT_SIZE);
+}
+
+void ArpMidiOutput::begin(MidiBuffer &midi) {
+    jassert(this->numEvents == 0);
+    this->target = &midi;
+}
+
+void ArpMidiOutput::addNoteOn(int channel, int note, float velocity, int offset) {
+    auto velocityByte = static_cast<uint8>(jlimit(0, 127, roundToInt(velocity * 127.0f)));
+    add(KIND_NOTE_ON, static_cast<uint8>(0x90 | (channel - 1)), note, velocityByte, offset);
+
+    this->noteOnOffsets[channel - 1][note] = offset;
+    this->noteOnGenerations[channel - 1][note] = this->generation;
+}
+
+void ArpMidiOutput::addNoteOff(int channel, int note, int offset) {
+    // The note off of a note turned on at the same offset is ordered like a note on, keeping it in sequence with it
+    auto isLate = this->noteOnGenerations[channel - 1][note] == this->generation
+            && this->noteOnOffsets[channel - 1][note] == offset;
+    add(isLate ? KIND_NOTE_ON : KIND_NOTE_OFF, static_cast<uint8>(0x80 | (channel - 1)), note, 0, offset);
+}
+
+void ArpMidiOutput::flush() {
+    if (this->numEvents == 0) {
+        return;
+    }
+
+    jassert(this->target != nullptr);
+    auto first = this->events.begin();
+    auto last = first + this->numEvents;
+
+    // The notes are generated mostly in order, so the sort can usually be skipped. The sequence number in the order
+    // makes the unstable sort stable.
+    if (!std::is_sorted(first, last)) {
+        std::sort(first, last);
+    }
+
+    auto &data = ArpMidiBufferLayout::getData(*this->target);
+    this->merged.clearQuick();
+    this->merged.resize(data.size() + this->numEvents * NOTE_EVENT_SIZE);
+
+    auto in = data.begin();
+    auto inEnd = data.end();
+    auto out = this->merged.getRawDataPointer();
+    auto event = first;
+    while (in < inEnd || event < last) {
+        if (in < inEnd && (event == last || ArpMidiBufferLayout::getTime(in) <= event->offset)) {
+            auto total = ArpMidiBufferLayout::getTotalSize(in);
+            std::copy(in, in + total, out);
+            in += total;
+            out += total;
+        } else {
+            out = ArpMidiBufferLayout::write(out, event->offset, event->bytes, NOTE_MESSAGE_SIZE);
+            ++event;
+        }
+    }
+
+    // Copying back keeps the storage of the host's buffer in place, unlike swapping
+    data.clearQuick();
+    data.addArray(this->merged.getRawDataPointer(), this->merged.size());
+
+    this->numEvents = 0;
+    if (++this->generation == 0) {
+        for (auto &channel : this->noteOnGenerations) {
+            for (auto &noteGeneration : channel) {
+                noteGeneration = 0;
+            }
+        }
+        this->generation = 1;
+    }
+}
+
+
+void ArpMidiOutput::add(uint32 kind, uint8 status, int note, uint8 velocity, int offset) {
+    jassert(note >= 0 && note < 128);
+    if (this->numEvents == static_cast<int>(this->events.size())) {
+        flush();
+    }
+
+    auto &event = this->events[static_cast<size_t>(this->numEvents)];
+    event.offset = offset;
+    event.order = (kind << KIND_SHIFT) | static_cast<uint32>(this->numEvents);
+    event.bytes[0] = status;
+    event.bytes[1] = static_cast<uint8>(note);
+    event.bytes[2] = velocity;
+    this->numEvents++;
+}
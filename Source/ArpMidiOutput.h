@@ -0,0 +1,176 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <vector>
+#include "JuceHeader.h"
+
+/**
+ * The output stage of the engine.
+ *
+ * Adding a message to a MidiBuffer searches for its place and moves all the later messages, so adding many notes one
+ * by one is quadratic. The output stage collects the generated notes into a preallocated array instead, and on flush
+ * sorts them by sample offset and merges them with the messages already in the buffer in a single linear pass over its
+ * raw data, see ArpMidiBufferLayout.
+ *
+ * At equal offsets, note offs are sent before note ons, so that a note retriggered at the same offset is not cut by its
+ * own note off. The only exception is the note off of a note turned on earlier at the same offset, which keeps its
+ * place after it. Messages already in the buffer are sent before the generated ones at equal offsets.
+ */
+class ArpMidiOutput {
+public:
+
+    /**
+     * The default number of notes collected before they are flushed.
+     */
+    static constexpr int DEFAULT_CAPACITY = 8192;
+
+    /**
+     * Constructs an output stage.
+     *
+     * @param capacity the number of notes collected before they are flushed early
+     */
+    explicit ArpMidiOutput(int capacity = DEFAULT_CAPACITY);
+
+
+
+    /**
+     * Preallocates the merge buffer, so that flushing does not allocate as long as the MIDI buffer stays under the
+     * specified size.
+     *
+     * @param maxBufferBytes the expected maximum size of the MIDI buffer data, in bytes
+     */
+    void prepare(int maxBufferBytes);
+
+    /**
+     * Starts collecting notes to be merged into the specified buffer.
+     *
+     * @param midi the MIDI buffer of the current block
+     */
+    void begin(MidiBuffer &midi);
+
+    /**
+     * Adds a note on. Flushes the collected notes first if the capacity is reached.
+     *
+     * @param channel the MIDI channel, from 1 to 16
+     * @param note the MIDI note number
+     * @param velocity the velocity, from 0.0 to 1.0
+     * @param offset the sample offset in the current block
+     */
+    void addNoteOn(int channel, int note, float velocity, int offset);
+
+    /**
+     * Adds a note off. Flushes the collected notes first if the capacity is reached.
+     *
+     * @param channel the MIDI channel, from 1 to 16
+     * @param note the MIDI note number
+     * @param offset the sample offset in the current block
+     */
+    void addNoteOff(int channel, int note, int offset);
+
+    /**
+     * Sorts the collected notes and merges them into the MIDI buffer.
+     */
+    void flush();
+
+private:
+
+    /**
+     * A collected note message.
+     */
+    class Event {
+    public:
+
+        /**
+         * The sample offset in the current block.
+         */
+        int offset;
+
+        /**
+         * The order of the message among the messages at the same offset: the kind of the message in the high bits,
+         * then the sequence number of the message.
+         */
+        uint32 order;
+
+        /**
+         * The bytes of the message.
+         */
+        uint8 bytes[3];
+
+
+
+        /**
+         * Orders the messages by offset, then by their order at the same offset.
+         */
+        bool operator<(const Event &other) const {
+            return offset < other.offset || (offset == other.offset && order < other.order);
+        }
+    };
+
+
+
+    /**
+     * The collected notes.
+     */
+    std::vector<Event> events;
+
+    /**
+     * The number of collected notes.
+     */
+    int numEvents;
+
+    /**
+     * The buffer the notes are merged into.
+     */
+    MidiBuffer *target;
+
+    /**
+     * Preallocated storage the buffer contents are merged in.
+     */
+    Array<uint8> merged;
+
+    /**
+     * The offset of the last note on of each channel and note, valid if its generation matches the current one.
+     */
+    int noteOnOffsets[16][128];
+
+    /**
+     * The generation of each entry of noteOnOffsets.
+     */
+    uint32 noteOnGenerations[16][128];
+
+    /**
+     * The generation of the collected notes, changed on every flush.
+     */
+    uint32 generation;
+
+
+
+    /**
+     * Adds a note message.
+     *
+     * @param kind the kind of the message, ordering it among the messages at the same offset
+     * @param status the status byte
+     * @param note the MIDI note number
+     * @param velocity the velocity byte
+     * @param offset the sample offset in the current block
+     */
+    void add(uint32 kind, uint8 status, int note, uint8 velocity, int offset);
+
+    JUCE_DECLARE_NON_COPYABLE(ArpMidiOutput);
+};
@@ -60,3 +60,19 @@ ArpNote ArpNote::fromValueTree(ValueTree &tree) {
 
     return result;
 }
+
+
+void ArpNote::writeBinary(OutputStream &stream) const {
+    stream.writeInt64(this->startPoint);
+    stream.writeInt64(this->endPoint);
+    this->data.writeBinary(stream);
+}
+
+
+ArpNote ArpNote::readBinary(InputStream &stream) {
+    ArpNote result = ArpNote();
+    result.startPoint = stream.readInt64();
+    result.endPoint = stream.readInt64();
+    result.data = NoteData::readBinary(stream);
+    return result;
+}
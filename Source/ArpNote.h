@@ -18,7 +18,7 @@
 #pragma once
 
 
-#include "../JuceLibraryCode/JuceHeader.h"
+#include "JuceHeader.h"
 #include "NoteData.h"
 
 /**
@@ -30,6 +30,11 @@ public:
     static const Identifier TREEID_START_POINT;
     static const Identifier TREEID_END_POINT;
 
+    /**
+     * The size of a note written by writeBinary, in bytes.
+     */
+    static const int BINARY_SIZE = 16 + NoteData::BINARY_SIZE;
+
     /**
      * Constructs a note with the specified data, or empty data if unspecified.
      *
@@ -68,6 +73,21 @@ public:
      * @return the note represented by the ValueTree
      */
     static ArpNote fromValueTree(ValueTree &tree);
+
+    /**
+     * Writes this note into a stream as a fixed-width record of BINARY_SIZE bytes.
+     *
+     * @param stream the stream to write into
+     */
+    void writeBinary(OutputStream &stream) const;
+
+    /**
+     * Reads a note written by writeBinary from a stream.
+     *
+     * @param stream the stream to read from
+     * @return the note read
+     */
+    static ArpNote readBinary(InputStream &stream);
 };
 
 
@@ -0,0 +1,258 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "ArpNoteResolver.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define LIBREARP_RESOLVER_SSE2 1
+    #endif
+    #if defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+        #define LIBREARP_RESOLVER_AVX2 1
+    #endif
+    #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define LIBREARP_RESOLVER_NEON 1
+    #include <arm_neon.h>
+#endif
+
+// The AVX2 kernel is compiled for AVX2 whatever the build flags, and only called once the CPU is known to support it
+#if defined(__GNUC__) || defined(__clang__)
+    #define LIBREARP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define LIBREARP_TARGET_AVX2
+#endif
+
+const int OCTAVE_SEMITONES = 12;
+
+/**
+ * Checks whether all the note numbers are within the range the SIMD kernels resolve exactly.
+ */
+static bool isWithinBatchRange(const int *noteNumbers, int count) {
+    bool result = true;
+    for (int i = 0; i < count; i++) {
+        result &= noteNumbers[i] < ArpNoteResolver::MAX_BATCH_NOTE_NUMBER
+                && noteNumbers[i] > -ArpNoteResolver::MAX_BATCH_NOTE_NUMBER;
+    }
+    return result;
+}
+
+
+#if LIBREARP_RESOLVER_SSE2
+// The octave of a note number is its floor quotient, minus one for the exact negative multiples of the number of
+// notes, as it has always been computed by the scalar implementation
+
+/**
+ * Resolves the note numbers four at a time with SSE2.
+ *
+ * SSE2 has neither a floor rounding nor a 32-bit multiplication, so the quotient estimate is truncated and fixed up in
+ * floating point, and the remainder is computed from the exact floating point product. There is no gather either, so
+ * the input notes are looked up lane by lane.
+ *
+ * @return the number of note numbers resolved
+ */
+static int resolveSse2(
+        const int *notes, int numNotes, float reciprocal, bool octaves,
+        const int *noteNumbers, int *destination, int count) {
+    const auto zero = _mm_setzero_si128();
+    const auto divisor = _mm_set1_epi32(numNotes);
+    const auto lastIndex = _mm_set1_epi32(numNotes - 1);
+    const auto divisorFloat = _mm_set1_ps(static_cast<float>(numNotes));
+    const auto reciprocalFloat = _mm_set1_ps(reciprocal);
+    const auto octaveMask = _mm_set1_epi32(octaves ? -1 : 0);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto n = _mm_loadu_si128(reinterpret_cast<const __m128i *>(noteNumbers + i));
+
+        // Floor of the estimated quotient, off by at most one from the exact one
+        auto estimate = _mm_mul_ps(_mm_cvtepi32_ps(n), reciprocalFloat);
+        auto q = _mm_cvttps_epi32(estimate);
+        q = _mm_add_epi32(q, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(q), estimate)));
+
+        auto r = _mm_sub_epi32(n, _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(q), divisorFloat)));
+        auto below = _mm_cmplt_epi32(r, zero);
+        r = _mm_add_epi32(r, _mm_and_si128(below, divisor));
+        q = _mm_add_epi32(q, below);
+        auto above = _mm_cmpgt_epi32(r, lastIndex);
+        r = _mm_sub_epi32(r, _mm_and_si128(above, divisor));
+        q = _mm_sub_epi32(q, above);
+        q = _mm_add_epi32(q, _mm_and_si128(_mm_cmplt_epi32(n, zero), _mm_cmpeq_epi32(r, zero)));
+
+        alignas(16) int indices[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(indices), r);
+        auto gathered = _mm_setr_epi32(notes[indices[0]], notes[indices[1]], notes[indices[2]], notes[indices[3]]);
+
+        auto octave = _mm_add_epi32(_mm_slli_epi32(q, 3), _mm_slli_epi32(q, 2));
+        auto result = _mm_add_epi32(gathered, _mm_and_si128(octave, octaveMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), result);
+    }
+    return i;
+}
+#endif
+
+#if LIBREARP_RESOLVER_AVX2
+/**
+ * Resolves the note numbers eight at a time with AVX2.
+ *
+ * @return the number of note numbers resolved
+ */
+LIBREARP_TARGET_AVX2 static int resolveAvx2(
+        const int *notes, int numNotes, float reciprocal, bool octaves,
+        const int *noteNumbers, int *destination, int count) {
+    const auto zero = _mm256_setzero_si256();
+    const auto divisor = _mm256_set1_epi32(numNotes);
+    const auto lastIndex = _mm256_set1_epi32(numNotes - 1);
+    const auto reciprocalFloat = _mm256_set1_ps(reciprocal);
+    const auto octaveStep = _mm256_set1_epi32(octaves ? OCTAVE_SEMITONES : 0);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto n = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(noteNumbers + i));
+
+        auto q = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(n), reciprocalFloat)));
+        auto r = _mm256_sub_epi32(n, _mm256_mullo_epi32(q, divisor));
+        auto below = _mm256_cmpgt_epi32(zero, r);
+        r = _mm256_add_epi32(r, _mm256_and_si256(below, divisor));
+        q = _mm256_add_epi32(q, below);
+        auto above = _mm256_cmpgt_epi32(r, lastIndex);
+        r = _mm256_sub_epi32(r, _mm256_and_si256(above, divisor));
+        q = _mm256_sub_epi32(q, above);
+        q = _mm256_add_epi32(q, _mm256_and_si256(_mm256_cmpgt_epi32(zero, n), _mm256_cmpeq_epi32(r, zero)));
+
+        auto gathered = _mm256_i32gather_epi32(notes, r, 4);
+        auto result = _mm256_add_epi32(gathered, _mm256_mullo_epi32(q, octaveStep));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i), result);
+    }
+    return i;
+}
+#endif
+
+#if LIBREARP_RESOLVER_NEON
+/**
+ * Resolves the note numbers four at a time with NEON. There is no gather, so the input notes are looked up lane by
+ * lane.
+ *
+ * @return the number of note numbers resolved
+ */
+static int resolveNeon(
+        const int *notes, int numNotes, float reciprocal, bool octaves,
+        const int *noteNumbers, int *destination, int count) {
+    const auto zero = vdupq_n_s32(0);
+    const auto divisor = vdupq_n_s32(numNotes);
+    const auto lastIndex = vdupq_n_s32(numNotes - 1);
+    const auto octaveStep = vdupq_n_s32(octaves ? OCTAVE_SEMITONES : 0);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto n = vld1q_s32(noteNumbers + i);
+
+        // Floor of the estimated quotient, off by at most one from the exact one
+        auto estimate = vmulq_n_f32(vcvtq_f32_s32(n), reciprocal);
+        auto q = vcvtq_s32_f32(estimate);
+        q = vaddq_s32(q, vreinterpretq_s32_u32(vcgtq_f32(vcvtq_f32_s32(q), estimate)));
+
+        auto r = vsubq_s32(n, vmulq_s32(q, divisor));
+        auto below = vreinterpretq_s32_u32(vcltq_s32(r, zero));
+        r = vaddq_s32(r, vandq_s32(below, divisor));
+        q = vaddq_s32(q, below);
+        auto above = vreinterpretq_s32_u32(vcgtq_s32(r, lastIndex));
+        r = vsubq_s32(r, vandq_s32(above, divisor));
+        q = vsubq_s32(q, above);
+        q = vaddq_s32(q, vreinterpretq_s32_u32(vandq_u32(vcltq_s32(n, zero), vceqq_s32(r, zero))));
+
+        int indices[4];
+        vst1q_s32(indices, r);
+        int lanes[4] = {notes[indices[0]], notes[indices[1]], notes[indices[2]], notes[indices[3]]};
+
+        auto result = vmlaq_s32(vld1q_s32(lanes), q, octaveStep);
+        vst1q_s32(destination + i, result);
+    }
+    return i;
+}
+#endif
+
+
+ArpNoteResolver::ArpNoteResolver() {
+    for (auto &note : this->notes) {
+        note = 0;
+    }
+    this->numNotes = 0;
+    this->reciprocal = 0.0f;
+    this->hasAvx2 = SystemStats::hasAVX2();
+}
+
+
+void ArpNoteResolver::setChord(const int *notes, int numNotes) {
+    jassert(numNotes > 0 && numNotes <= MAX_NOTES);
+    for (int i = 0; i < numNotes; i++) {
+        this->notes[i] = notes[i];
+    }
+    this->numNotes = numNotes;
+    this->reciprocal = 1.0f / static_cast<float>(numNotes);
+}
+
+int ArpNoteResolver::getNumNotes() const {
+    return this->numNotes;
+}
+
+
+int ArpNoteResolver::getInputNote(int noteNumber) const {
+    jassert(this->numNotes > 0);
+    auto index = noteNumber % this->numNotes;
+    if (index < 0) {
+        index += this->numNotes;
+    }
+    return this->notes[index];
+}
+
+int ArpNoteResolver::resolve(int noteNumber, bool octaves) const {
+    auto note = getInputNote(noteNumber);
+    if (octaves) {
+        auto octave = noteNumber / this->numNotes;
+        if (noteNumber < 0) {
+            octave--;
+        }
+        note += octave * OCTAVE_SEMITONES;
+    }
+    return note;
+}
+
+void ArpNoteResolver::resolve(const int *noteNumbers, int *destination, int count, bool octaves) const {
+    jassert(this->numNotes > 0);
+    int done = 0;
+
+    if (isWithinBatchRange(noteNumbers, count)) {
+#if LIBREARP_RESOLVER_AVX2
+        if (this->hasAvx2) {
+            done = resolveAvx2(this->notes, this->numNotes, this->reciprocal, octaves, noteNumbers, destination, count);
+        }
+#endif
+#if LIBREARP_RESOLVER_SSE2
+        done += resolveSse2(
+                this->notes, this->numNotes, this->reciprocal, octaves,
+                noteNumbers + done, destination + done, count - done);
+#endif
+#if LIBREARP_RESOLVER_NEON
+        done = resolveNeon(this->notes, this->numNotes, this->reciprocal, octaves, noteNumbers, destination, count);
+#endif
+    }
+
+    for (int i = done; i < count; i++) {
+        destination[i] = resolve(noteNumbers[i], octaves);
+    }
+}
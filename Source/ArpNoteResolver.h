@@ -0,0 +1,115 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include "JuceHeader.h"
+
+/**
+ * Resolves pattern note numbers to output MIDI notes in batches.
+ *
+ * A pattern note number indexes the ascending input notes modulo their count, and with octaves enabled each time it
+ * wraps around the notes are transposed by an octave. The resolver keeps a flat copy of the input notes and the
+ * reciprocal of their count, so the floor division becomes a multiplication followed by a correction step, and
+ * resolves several note numbers at once with SSE2 or AVX2 on x86 and NEON on ARM. A scalar implementation handles the
+ * remainder of a batch and the platforms without SIMD support.
+ */
+class ArpNoteResolver {
+public:
+
+    /**
+     * The maximum number of input notes.
+     */
+    static constexpr int MAX_NOTES = 128;
+
+    /**
+     * The exclusive bound of the magnitude of note numbers the SIMD implementations resolve exactly. Batches with note
+     * numbers outside of it are resolved by the scalar implementation.
+     */
+    static constexpr int MAX_BATCH_NOTE_NUMBER = 1 << 22;
+
+    /**
+     * Constructs a resolver with no input notes and picks the fastest implementation the CPU supports.
+     */
+    ArpNoteResolver();
+
+
+
+    /**
+     * Sets the input notes the note numbers are resolved against.
+     *
+     * @param notes the input MIDI notes in ascending order
+     * @param numNotes the number of input notes, from 1 to MAX_NOTES
+     */
+    void setChord(const int *notes, int numNotes);
+
+    /**
+     * Gets the number of input notes.
+     *
+     * @return the number of input notes
+     */
+    int getNumNotes() const;
+
+    /**
+     * Gets the input note a note number maps to, before any octave transposition.
+     *
+     * @param noteNumber the note number of a pattern note
+     * @return the input MIDI note number
+     */
+    int getInputNote(int noteNumber) const;
+
+    /**
+     * Resolves a single note number.
+     *
+     * @param noteNumber the note number of a pattern note
+     * @param octaves whether octaves are transposed upon "note overflow"
+     * @return the output MIDI note number
+     */
+    int resolve(int noteNumber, bool octaves) const;
+
+    /**
+     * Resolves a batch of note numbers.
+     *
+     * @param noteNumbers the note numbers of the pattern notes
+     * @param destination the array the output MIDI note numbers are written to
+     * @param count the number of note numbers to resolve
+     * @param octaves whether octaves are transposed upon "note overflow"
+     */
+    void resolve(const int *noteNumbers, int *destination, int count, bool octaves) const;
+
+private:
+
+    /**
+     * The input notes in ascending order.
+     */
+    int notes[MAX_NOTES];
+
+    /**
+     * The number of input notes.
+     */
+    int numNotes;
+
+    /**
+     * The reciprocal of the number of input notes.
+     */
+    float reciprocal;
+
+    /**
+     * Whether the CPU supports AVX2.
+     */
+    bool hasAvx2;
+};
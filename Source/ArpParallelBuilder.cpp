@@ -0,0 +1,189 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+#include <thread>
+#include "ArpParallelBuilder.h"
+
+ArpParallelBuilder::ArpParallelBuilder(int numThreads) {
+    this->numThreads = jmax(1, numThreads);
+}
+
+
+int ArpParallelBuilder::getNumThreads() const {
+    return this->numThreads;
+}
+
+ArpBuiltEvents ArpParallelBuilder::build(const ArpPattern &pattern) {
+    using EventRecord = ArpPattern::EventRecord;
+
+    ArpBuiltEvents result;
+    result.timebase = pattern.getTimebase();
+    result.loopLength = pattern.loopLength;
+
+    auto &notes = pattern.getNotes();
+    auto numNotes = notes.size();
+    auto numRecords = numNotes * 2;
+
+    // Each note emits its on and its off at fixed positions, so the chunks need no coordination
+    std::vector<EventRecord> records(numRecords);
+    result.data.resize(numNotes);
+    parallelFor(numNotes, [&](size_t, size_t first, size_t last) {
+        for (auto i = first; i < last; i++) {
+            auto &note = notes[i];
+            auto dataIndex = static_cast<uint32>(i);
+            result.data[i] = ArpBuiltEvents::EventNoteData::of(note.data, i);
+            records[2 * i] = EventRecord { pattern.wrapTime(note.startPoint), EventRecord::KIND_ON, dataIndex };
+            records[2 * i + 1] = EventRecord { pattern.wrapTime(note.endPoint), EventRecord::KIND_OFF, dataIndex };
+        }
+    });
+
+    sort(records);
+
+    auto isEventStart = [&](size_t i) {
+        return i == 0 || records[i].time != records[i - 1].time;
+    };
+
+    // First pass of the scan: the number of events starting in each chunk
+    std::vector<size_t> chunkEvents(getNumChunks(numRecords) + 1, 0);
+    result.indices.resize(numRecords);
+    parallelFor(numRecords, [&](size_t chunk, size_t first, size_t last) {
+        size_t count = 0;
+        for (auto i = first; i < last; i++) {
+            result.indices[i] = records[i].dataIndex;
+            if (isEventStart(i)) {
+                count++;
+            }
+        }
+        chunkEvents[chunk + 1] = count;
+    });
+
+    for (size_t chunk = 1; chunk < chunkEvents.size(); chunk++) {
+        chunkEvents[chunk] += chunkEvents[chunk - 1];
+    }
+
+    auto numEvents = chunkEvents.back();
+    result.times.resize(numEvents);
+    result.offsets.resize(numEvents * 2 + 1);
+    result.offsets[numEvents * 2] = static_cast<uint32>(numRecords);
+
+    // Second pass: every chunk numbers its events from the count of the chunks before it. The on-data of an event
+    // starts at its first on, or at its end if it has none.
+    parallelFor(numRecords, [&](size_t chunk, size_t first, size_t last) {
+        auto event = chunkEvents[chunk];
+        for (auto i = first; i < last; i++) {
+            if (isEventStart(i)) {
+                event++;
+                result.times[event - 1] = records[i].time;
+                result.offsets[2 * (event - 1)] = static_cast<uint32>(i);
+            }
+
+            auto &record = records[i];
+            if (record.kind == EventRecord::KIND_ON) {
+                if (isEventStart(i) || records[i - 1].kind == EventRecord::KIND_OFF) {
+                    result.offsets[2 * (event - 1) + 1] = static_cast<uint32>(i);
+                }
+            } else if (i + 1 == numRecords || isEventStart(i + 1)) {
+                result.offsets[2 * (event - 1) + 1] = static_cast<uint32>(i + 1);
+            }
+        }
+    });
+
+    // The ons come out sorted like the intervals, by start and then by note data index
+    for (auto &record : records) {
+        if (record.kind == EventRecord::KIND_ON) {
+            auto end = pattern.wrapTime(notes[record.dataIndex].endPoint);
+            result.intervals.add(record.time, pattern.getSoundingEnd(record.time, end), record.dataIndex);
+        }
+    }
+    result.intervals.link();
+
+    return result;
+}
+
+
+size_t ArpParallelBuilder::getNumChunks(size_t count) const {
+    auto chunks = (count + MIN_CHUNK_SIZE - 1) / MIN_CHUNK_SIZE;
+    return jlimit(static_cast<size_t>(1), static_cast<size_t>(this->numThreads), chunks);
+}
+
+template <typename Function>
+void ArpParallelBuilder::parallelFor(size_t count, Function &&function) {
+    auto numChunks = getNumChunks(count);
+    auto chunkStart = [&](size_t chunk) {
+        return count * chunk / numChunks;
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(numChunks - 1);
+    for (size_t chunk = 1; chunk < numChunks; chunk++) {
+        threads.emplace_back([&, chunk]() {
+            function(chunk, chunkStart(chunk), chunkStart(chunk + 1));
+        });
+    }
+
+    function(0, chunkStart(0), chunkStart(1));
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+void ArpParallelBuilder::sort(std::vector<ArpPattern::EventRecord> &records) {
+    auto count = records.size();
+    auto numChunks = getNumChunks(count);
+
+    std::vector<size_t> bounds;
+    for (size_t chunk = 0; chunk <= numChunks; chunk++) {
+        bounds.push_back(count * chunk / numChunks);
+    }
+
+    parallelFor(count, [&](size_t, size_t first, size_t last) {
+        std::sort(records.begin() + first, records.begin() + last);
+    });
+
+    // Every round merges neighbouring runs into the other buffer, halving the number of runs
+    std::vector<ArpPattern::EventRecord> buffer(count);
+    auto *source = &records;
+    auto *destination = &buffer;
+    while (bounds.size() > 2) {
+        auto numRuns = bounds.size() - 1;
+        std::vector<size_t> merged;
+        std::vector<std::thread> threads;
+        for (size_t run = 0; run < numRuns; run += 2) {
+            merged.push_back(bounds[run]);
+            auto first = bounds[run];
+            auto middle = bounds[run + 1];
+            auto last = bounds[jmin(run + 2, numRuns)];
+            threads.emplace_back([source, destination, first, middle, last]() {
+                std::merge(source->begin() + first, source->begin() + middle,
+                        source->begin() + middle, source->begin() + last,
+                        destination->begin() + first);
+            });
+        }
+        merged.push_back(count);
+
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        bounds.swap(merged);
+        std::swap(source, destination);
+    }
+
+    if (source != &records) {
+        records.swap(buffer);
+    }
+}
@@ -0,0 +1,103 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "ArpPattern.h"
+
+/**
+ * Builds the events of large patterns on several threads.
+ *
+ * The on and off records of the notes are emitted into a flat array in parallel chunks, sorted by sorting the chunks
+ * in parallel and merging them pairwise, and turned into the event arrays with a parallel prefix scan over the event
+ * boundaries. The records are totally ordered, so the result is the same as that of ArpPattern::buildEvents for any
+ * number of threads.
+ */
+class ArpParallelBuilder {
+public:
+
+    /**
+     * The number of notes from which building on several threads pays off.
+     */
+    static constexpr size_t MIN_PARALLEL_NOTES = 16384;
+
+    /**
+     * Constructs a builder.
+     *
+     * @param numThreads the maximum number of threads to build with, including the calling thread
+     */
+    explicit ArpParallelBuilder(int numThreads = SystemStats::getNumCpus());
+
+
+
+    /**
+     * Gets the maximum number of threads the builder builds with.
+     *
+     * @return the maximum number of threads
+     */
+    int getNumThreads() const;
+
+    /**
+     * Builds events from the specified pattern.
+     *
+     * @param pattern the pattern to build
+     * @return the same events as ArpPattern::buildEvents would build
+     */
+    ArpBuiltEvents build(const ArpPattern &pattern);
+
+private:
+
+    /**
+     * The minimum number of items handed to a thread.
+     */
+    static constexpr size_t MIN_CHUNK_SIZE = 4096;
+
+    /**
+     * The maximum number of threads.
+     */
+    int numThreads;
+
+
+
+    /**
+     * Gets the number of chunks a range of items is split into.
+     *
+     * @param count the number of items
+     * @return the number of chunks, from 1 to numThreads
+     */
+    size_t getNumChunks(size_t count) const;
+
+    /**
+     * Calls the function for consecutive chunks of a range of items, each on its own thread, and waits for all of
+     * them to return. The chunks only depend on the number of items, so two calls over the same number of items
+     * split it the same way.
+     *
+     * @param count the number of items
+     * @param function the function called as function(chunk, first, last) for every chunk of items from first
+     * (inclusive) to last (exclusive)
+     */
+    template <typename Function>
+    void parallelFor(size_t count, Function &&function);
+
+    /**
+     * Sorts the records by sorting chunks of them in parallel and merging the sorted chunks pairwise.
+     *
+     * @param records the records to sort
+     */
+    void sort(std::vector<ArpPattern::EventRecord> &records);
+};
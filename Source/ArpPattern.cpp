@@ -15,7 +15,7 @@
 // along with this program.  If not, see https://librearp.gitlab.io/license/.
 //
 
-#include <map>
+#include <algorithm>
 #include "ArpPattern.h"
 #include "exception/ArpIntegrityException.h"
 
@@ -24,6 +24,8 @@ const Identifier ArpPattern::TREEID_TIMEBASE = Identifier("timebase"); // NOLINT
 const Identifier ArpPattern::TREEID_LOOP_LENGTH = Identifier("loopLength"); // NOLINT
 const Identifier ArpPattern::TREEID_NOTES = Identifier("notes"); // NOLINT
 
+const int64 BINARY_HEADER_SIZE = 16; // Timebase, loop length and number of notes
+
 ArpPattern::ArpPattern(int timebase) {
     this->timebase = timebase;
     this->loopLength = timebase;
@@ -33,50 +35,145 @@ ArpPattern::ArpPattern(int timebase) {
 ArpPattern::~ArpPattern() = default;
 
 
-int ArpPattern::getTimebase() {
+int ArpPattern::getTimebase() const {
     return this->timebase;
 }
 
+void ArpPattern::setTimebase(int newTimebase) {
+    if (newTimebase <= 0) {
+        throw std::invalid_argument("The timebase must be positive!");
+    }
+
+    auto rescale = [&](int64 pulses) {
+        return static_cast<int64>(std::llround(static_cast<double>(pulses) * newTimebase / this->timebase));
+    };
+
+    for (auto &note : this->notes) {
+        note.startPoint = rescale(note.startPoint);
+        note.endPoint = jmax(note.startPoint + 1, rescale(note.endPoint));
+    }
+    this->loopLength = jmax(static_cast<int64>(1), rescale(this->loopLength));
+    this->timebase = newTimebase;
+}
+
 std::vector<ArpNote> &ArpPattern::getNotes() {
     return this->notes;
 }
 
+const std::vector<ArpNote> &ArpPattern::getNotes() const {
+    return this->notes;
+}
+
 
-ArpBuiltEvents ArpPattern::buildEvents() {
-    std::map<int64, ArpBuiltEvents::Event> eventMap;
+ArpBuiltEvents ArpPattern::buildEvents() const {
     ArpBuiltEvents result;
 
     result.timebase = this->timebase;
     result.loopLength = this->loopLength;
 
+    // Flat records of all the ons and offs, sorted by time with offs first
+    std::vector<EventRecord> records;
+    records.reserve(this->notes.size() * 2);
+    result.data.reserve(this->notes.size());
+
     for (unsigned long i = 0; i < this->notes.size(); i++) {
         auto &note = this->notes[i];
 
-        auto dataIndex = result.data.size();
+        auto dataIndex = static_cast<uint32>(result.data.size());
         result.data.push_back(ArpBuiltEvents::EventNoteData::of(note.data, i));
 
-        int64 onTime = note.startPoint % loopLength;
-        ArpBuiltEvents::Event &onEvent = eventMap[onTime];
-        onEvent.time = onTime;
-        onEvent.ons.insert(dataIndex);
+        auto start = wrapTime(note.startPoint);
+        auto end = wrapTime(note.endPoint);
+        records.push_back(EventRecord { start, EventRecord::KIND_ON, dataIndex });
+        records.push_back(EventRecord { end, EventRecord::KIND_OFF, dataIndex });
+        result.intervals.add(start, getSoundingEnd(start, end), dataIndex);
+    }
+
+    std::sort(records.begin(), records.end());
+    result.intervals.build();
+
+    result.indices.reserve(records.size());
+    bool onsStarted = false;
+    for (auto &record : records) {
+        if (result.times.empty() || result.times.back() != record.time) {
+            if (!result.times.empty() && !onsStarted) {
+                result.offsets.push_back(static_cast<uint32>(result.indices.size()));
+            }
+            result.times.push_back(record.time);
+            result.offsets.push_back(static_cast<uint32>(result.indices.size()));
+            onsStarted = false;
+        }
 
-        int64 offTime = note.endPoint % loopLength;
-        ArpBuiltEvents::Event &offEvent = eventMap[offTime];
-        offEvent.time = offTime;
-        offEvent.offs.insert(dataIndex);
+        if (record.kind == EventRecord::KIND_ON && !onsStarted) {
+            result.offsets.push_back(static_cast<uint32>(result.indices.size()));
+            onsStarted = true;
+        }
 
-        ArpBuiltEvents::Event &totalOffEvent = eventMap[0];
-        totalOffEvent.time = 0;
-        totalOffEvent.offs.insert(dataIndex);
+        result.indices.push_back(record.dataIndex);
     }
 
-    for (std::pair<int64, ArpBuiltEvents::Event> pair : eventMap) {
-        result.events.push_back(pair.second);
+    if (!result.times.empty() && !onsStarted) {
+        result.offsets.push_back(static_cast<uint32>(result.indices.size()));
     }
+    result.offsets.push_back(static_cast<uint32>(result.indices.size()));
 
     return result;
 }
 
+bool ArpPattern::canUpdateEvents(const ArpPattern &previous) const {
+    return this->timebase == previous.timebase
+            && this->loopLength == previous.loopLength
+            && this->notes.size() == previous.notes.size();
+}
+
+void ArpPattern::updateEvents(
+        ArpBuiltEvents &events,
+        const ArpPattern &previous,
+        const std::vector<uint64> &changedNotes) const {
+
+    jassert(canUpdateEvents(previous));
+
+    for (auto i : changedNotes) {
+        auto &oldNote = previous.notes[i];
+        auto &note = this->notes[i];
+
+        // The data of each note is built at the index of the note
+        auto dataIndex = static_cast<uint32>(i);
+        auto oldStart = wrapTime(oldNote.startPoint);
+        events.removeEntry(oldStart, true, dataIndex);
+        events.removeEntry(wrapTime(oldNote.endPoint), false, dataIndex);
+
+        auto start = wrapTime(note.startPoint);
+        auto end = wrapTime(note.endPoint);
+        events.insertEntry(start, true, dataIndex);
+        events.insertEntry(end, false, dataIndex);
+
+        events.data[i] = ArpBuiltEvents::EventNoteData::of(note.data, i);
+        events.intervals.replace(dataIndex, oldStart, start, getSoundingEnd(start, end));
+    }
+
+    events.intervals.link();
+}
+
+int64 ArpPattern::wrapTime(int64 time) const {
+    auto result = time % this->loopLength;
+    return (result < 0) ? result + this->loopLength : result;
+}
+
+int64 ArpPattern::getSoundingEnd(int64 start, int64 end) const {
+    return (end > start) ? end : this->loopLength;
+}
+
+bool ArpPattern::EventRecord::operator<(const EventRecord &other) const {
+    if (this->time != other.time) {
+        return this->time < other.time;
+    }
+    if (this->kind != other.kind) {
+        return this->kind < other.kind;
+    }
+    return this->dataIndex < other.dataIndex;
+}
+
 ValueTree ArpPattern::toValueTree() {
     ValueTree result = ValueTree(TREEID_PATTERN);
 
@@ -118,3 +215,39 @@ ArpPattern ArpPattern::fromValueTree(ValueTree &tree) {
 
     return result;
 }
+
+
+void ArpPattern::writeBinary(OutputStream &stream) const {
+    stream.writeInt(this->timebase);
+    stream.writeInt64(this->loopLength);
+    stream.writeInt(static_cast<int>(this->notes.size()));
+    for (auto &note : this->notes) {
+        note.writeBinary(stream);
+    }
+}
+
+
+ArpPattern ArpPattern::readBinary(InputStream &stream) {
+    if (stream.getNumBytesRemaining() < BINARY_HEADER_SIZE) {
+        throw ArpIntegrityException("Truncated pattern data!");
+    }
+
+    auto timebase = stream.readInt();
+    auto loopLength = stream.readInt64();
+    auto numNotes = stream.readInt();
+    if (timebase <= 0 || loopLength <= 0 || numNotes < 0) {
+        throw ArpIntegrityException("Invalid pattern data!");
+    }
+    if (stream.getNumBytesRemaining() < static_cast<int64>(numNotes) * ArpNote::BINARY_SIZE) {
+        throw ArpIntegrityException("Truncated pattern data!");
+    }
+
+    ArpPattern result = ArpPattern(timebase);
+    result.loopLength = loopLength;
+    result.notes.reserve(static_cast<size_t>(numNotes));
+    for (int i = 0; i < numNotes; i++) {
+        result.notes.push_back(ArpNote::readBinary(stream));
+    }
+
+    return result;
+}
@@ -17,7 +17,7 @@
 
 #pragma once
 
-#include "../JuceLibraryCode/JuceHeader.h"
+#include "JuceHeader.h"
 #include "ArpNote.h"
 #include "ArpBuiltEvents.h"
 
@@ -25,6 +25,8 @@
  * A data class of a pattern, editable by the user.
  */
 class ArpPattern {
+    friend class ArpParallelBuilder;
+
 public:
 
     static const Identifier TREEID_PATTERN;
@@ -61,7 +63,15 @@ public:
      *
      * @return the timebase of the pattern in PPQ
      */
-    int getTimebase();
+    int getTimebase() const;
+
+    /**
+     * Changes the timebase of the pattern, rescaling the notes and the loop length to the new one. Going up to a
+     * multiple of the current timebase, e.g. from 96 to 960 or 1920 PPQ, keeps all the timing exact.
+     *
+     * @param newTimebase the new timebase in PPQ
+     */
+    void setTimebase(int newTimebase);
 
     /**
      * Gets a pointer to the vector of notes in this pattern.
@@ -70,14 +80,44 @@ public:
      */
     std::vector<ArpNote> &getNotes();
 
+    /**
+     * Gets the vector of notes in this pattern, for reading only.
+     *
+     * @return the notes in this pattern
+     */
+    const std::vector<ArpNote> &getNotes() const;
+
 
 
     /**
-     * Builds events from this pattern.
+     * Builds events from this pattern. Notes are turned off at their end point, or at the end of the loop, whichever
+     * comes first; the latter is left to the player.
      *
      * @return ArpBuiltEvents built from this pattern
      */
-    ArpBuiltEvents buildEvents();
+    ArpBuiltEvents buildEvents() const;
+
+    /**
+     * Checks whether events built from a previous version of this pattern can be updated in place by updateEvents,
+     * which requires the timebase, the loop length and the number of notes to be the same.
+     *
+     * @param previous the previous version of the pattern
+     * @return true if the events can be updated in place
+     */
+    bool canUpdateEvents(const ArpPattern &previous) const;
+
+    /**
+     * Updates events built from a previous version of this pattern, re-inserting only the ons and offs of the notes
+     * that have changed. The result is the same as if the events had been built from this pattern.
+     *
+     * @param events the events built from the previous version, updated in place
+     * @param previous the previous version of the pattern, for which canUpdateEvents holds
+     * @param changedNotes the indices of the notes that have changed, without duplicates
+     */
+    void updateEvents(
+            ArpBuiltEvents &events,
+            const ArpPattern &previous,
+            const std::vector<uint64> &changedNotes) const;
 
 
 
@@ -96,8 +136,56 @@ public:
      */
     static ArpPattern fromValueTree(ValueTree &tree);
 
+    /**
+     * Writes this pattern into a stream in a compact binary form: the timebase, the loop length and the number of
+     * notes, followed by a fixed-width record for every note.
+     *
+     * @param stream the stream to write into
+     */
+    void writeBinary(OutputStream &stream) const;
+
+    /**
+     * Reads a pattern written by writeBinary from a stream, which must know how many bytes it has left.
+     *
+     * @param stream the stream to read from
+     * @return the pattern read
+     * @throws ArpIntegrityException if the data is truncated or invalid
+     */
+    static ArpPattern readBinary(InputStream &stream);
+
 private:
 
+    /**
+     * A single on or off of a note data, used while building events.
+     */
+    class EventRecord {
+    public:
+        static const uint32 KIND_OFF = 0;
+        static const uint32 KIND_ON = 1;
+
+        /**
+         * The time in the pattern.
+         */
+        int64 time;
+
+        /**
+         * Whether this is an off or an on.
+         */
+        uint32 kind;
+
+        /**
+         * The index of the note data.
+         */
+        uint32 dataIndex;
+
+        /**
+         * Orders records by time, offs before ons, then by data index.
+         */
+        bool operator<(const EventRecord &other) const;
+    };
+
+
+
     /**
      * The timebase of the pattern.
      * Defines the amount of pulses in one beat.
@@ -108,4 +196,24 @@ private:
      * The notes in the pattern.
      */
     std::vector<ArpNote> notes;
+
+
+
+    /**
+     * Wraps the specified time into the loop.
+     *
+     * @param time the time in pulses
+     * @return the time in the loop, from zero (inclusive) to loopLength (exclusive)
+     */
+    int64 wrapTime(int64 time) const;
+
+    /**
+     * Gets the end of the interval a note sounds in within a loop iteration. A note whose off wraps around is cut by
+     * the start of the next loop iteration instead.
+     *
+     * @param start the wrapped start of the note
+     * @param end the wrapped end of the note
+     * @return the end of the interval in pulses
+     */
+    int64 getSoundingEnd(int64 start, int64 end) const;
 };
@@ -0,0 +1,156 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "ArpPatternCompiler.h"
+
+ArpPatternCompiler::ArpPatternCompiler() : Thread("LibreArp pattern compiler"), numPendingBuilds(0) {
+    this->pendingFullBuild = true;
+    this->published = nullptr;
+    this->retired = nullptr;
+    startThread();
+}
+
+ArpPatternCompiler::~ArpPatternCompiler() {
+    stopThread(1000);
+    delete this->published.exchange(nullptr);
+    delete this->retired.exchange(nullptr);
+}
+
+
+void ArpPatternCompiler::compile(std::shared_ptr<const ArpPattern> pattern) {
+    {
+        const ScopedLock lock(patternLock);
+        if (pendingPattern == nullptr) {
+            numPendingBuilds++;
+        }
+        pendingPattern = std::move(pattern);
+        pendingChanges.clear();
+        pendingFullBuild = true;
+    }
+    notify();
+}
+
+void ArpPatternCompiler::compile(std::shared_ptr<const ArpPattern> pattern, const std::vector<uint64> &changedNotes) {
+    {
+        const ScopedLock lock(patternLock);
+        if (pendingPattern == nullptr) {
+            numPendingBuilds++;
+        }
+        pendingPattern = std::move(pattern);
+
+        // The changes accumulate until the worker picks them up, so that they are all relative to the last build
+        if (!pendingFullBuild) {
+            pendingChanges.insert(pendingChanges.end(), changedNotes.begin(), changedNotes.end());
+            std::sort(pendingChanges.begin(), pendingChanges.end());
+            pendingChanges.erase(std::unique(pendingChanges.begin(), pendingChanges.end()), pendingChanges.end());
+            pendingFullBuild = pendingChanges.size() > MAX_UPDATED_NOTES;
+        }
+    }
+    notify();
+}
+
+bool ArpPatternCompiler::waitForBuilds(int timeoutMs) {
+    auto endTime = Time::getMillisecondCounter() + static_cast<uint32>(timeoutMs);
+    while (numPendingBuilds.load() > 0 || this->retired.load() != nullptr) {
+        auto now = Time::getMillisecondCounter();
+        if (now >= endTime) {
+            return false;
+        }
+        notify();
+        workDoneEvent.wait(jmin(RECLAIM_INTERVAL_MS, static_cast<int>(endTime - now)));
+    }
+    return true;
+}
+
+bool ArpPatternCompiler::canSwap() const {
+    return this->retired.load() == nullptr && this->published.load() != nullptr;
+}
+
+ArpBuiltEvents *ArpPatternCompiler::acquire() {
+    // The previously retired events have to be deleted first, so that there is always at most one retired object
+    // and the audio thread never has to wait for or allocate anything
+    if (this->retired.load() != nullptr) {
+        return nullptr;
+    }
+
+    return this->published.exchange(nullptr);
+}
+
+void ArpPatternCompiler::retire(ArpBuiltEvents *events) {
+    jassert(this->retired.load() == nullptr);
+    this->retired.store(events);
+}
+
+void ArpPatternCompiler::reclaimRetired() {
+    if (this->retired.load() != nullptr) {
+        notify();
+    }
+}
+
+
+void ArpPatternCompiler::run() {
+    while (!threadShouldExit()) {
+        // The audio thread cannot swap in published events while retired ones are waiting for deletion, and cannot
+        // notify the worker either, so only then does the worker poll. Otherwise it sleeps until notified.
+        auto isSwapBlocked = this->published.load() != nullptr && this->retired.load() != nullptr;
+        wait(isSwapBlocked ? RECLAIM_INTERVAL_MS : -1);
+        reclaim();
+
+        std::shared_ptr<const ArpPattern> pattern;
+        std::vector<uint64> changes;
+        bool fullBuild;
+        {
+            const ScopedLock lock(patternLock);
+            pattern.swap(pendingPattern);
+            changes.swap(pendingChanges);
+            fullBuild = pendingFullBuild;
+            pendingFullBuild = false;
+        }
+
+        if (pattern != nullptr) {
+            build(std::move(pattern), changes, fullBuild);
+
+            // Events published earlier and never picked up by the audio thread can be deleted right away
+            delete this->published.exchange(new ArpBuiltEvents(*builtEvents));
+            numPendingBuilds--;
+        }
+
+        workDoneEvent.signal();
+    }
+}
+
+void ArpPatternCompiler::build(
+        std::shared_ptr<const ArpPattern> pattern,
+        const std::vector<uint64> &changes,
+        bool fullBuild) {
+
+    if (fullBuild || builtEvents == nullptr || !pattern->canUpdateEvents(*builtPattern)) {
+        auto isLarge = pattern->getNotes().size() >= ArpParallelBuilder::MIN_PARALLEL_NOTES;
+        if (isLarge && parallelBuilder.getNumThreads() > 1) {
+            builtEvents = std::make_unique<ArpBuiltEvents>(parallelBuilder.build(*pattern));
+        } else {
+            builtEvents = std::make_unique<ArpBuiltEvents>(pattern->buildEvents());
+        }
+    } else {
+        pattern->updateEvents(*builtEvents, *builtPattern, changes);
+    }
+    builtPattern = std::move(pattern);
+}
+
+void ArpPatternCompiler::reclaim() {
+    delete this->retired.exchange(nullptr);
+}
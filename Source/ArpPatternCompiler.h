@@ -0,0 +1,201 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "JuceHeader.h"
+#include "ArpParallelBuilder.h"
+#include "ArpPattern.h"
+
+/**
+ * Builds patterns into events on a dedicated background thread.
+ *
+ * The message thread schedules an immutable version of the pattern for compilation, the worker thread builds it and
+ * publishes the result through an atomic pointer. The audio thread picks up the most recently published events and
+ * hands the ones it stopped using back to the compiler, which deletes them on the worker thread. The audio thread thus
+ * never builds, allocates nor frees events, and the built events are never shared by two threads at once.
+ *
+ * The worker thread sleeps until it is notified of a build or of retired events to delete, and only polls while
+ * retired events keep the audio thread from swapping in a published build.
+ */
+class ArpPatternCompiler : private Thread {
+public:
+
+    /**
+     * Constructs the compiler and starts its worker thread.
+     */
+    ArpPatternCompiler();
+
+    /**
+     * Stops the worker thread and deletes all the events still owned by the compiler.
+     */
+    ~ArpPatternCompiler() override;
+
+
+
+    /**
+     * Schedules a build of the specified pattern. The pattern is shared with the worker thread rather than copied,
+     * so it must not be modified anymore. If a build is scheduled before the previous one has been picked up, only
+     * the latest one is built.
+     *
+     * @param pattern the pattern to build
+     */
+    void compile(std::shared_ptr<const ArpPattern> pattern);
+
+    /**
+     * Schedules a build of the specified pattern, in which only the specified notes have changed since the last
+     * scheduled build. The events built last are then updated in place instead of being rebuilt, unless the timebase,
+     * the loop length or the number of notes have changed too.
+     *
+     * @param pattern the pattern to build, which must not be modified anymore
+     * @param changedNotes the indices of the notes that have changed
+     */
+    void compile(std::shared_ptr<const ArpPattern> pattern, const std::vector<uint64> &changedNotes);
+
+    /**
+     * Blocks until all the scheduled builds are published and ready to be swapped in. Meant for non-realtime
+     * processing only.
+     *
+     * @param timeoutMs the maximum time to wait in milliseconds
+     * @return true if there are no scheduled builds left
+     */
+    bool waitForBuilds(int timeoutMs);
+
+    /**
+     * Checks whether a call to acquire would return new events. Only the audio thread may make this change, so the
+     * result holds until it calls acquire.
+     *
+     * @return true if there are new events to switch to
+     */
+    bool canSwap() const;
+
+    /**
+     * Takes the most recently published events, if there are any and the previously retired ones have been deleted.
+     * The caller has to retire the events it is replacing with them, after it is done carrying its state over.
+     * Lock-free and allocation-free; to be called from the audio thread only.
+     *
+     * @return the events the caller should use from now on, owned by the caller; null if there are no new events to
+     * switch to
+     */
+    ArpBuiltEvents *acquire();
+
+    /**
+     * Hands events the audio thread has stopped using over to the compiler for deletion. Must follow a successful
+     * call to acquire. Lock-free and allocation-free; to be called from the audio thread only.
+     *
+     * @param events the replaced events, owned by the caller
+     */
+    void retire(ArpBuiltEvents *events);
+
+    /**
+     * Wakes the worker thread up to delete the retired events, if there are any. Meant to be polled from the message
+     * thread, since the audio thread cannot notify the worker without locking.
+     */
+    void reclaimRetired();
+
+private:
+
+    /**
+     * The interval in which the worker thread polls for retired events while they block a swap, in milliseconds.
+     */
+    static constexpr int RECLAIM_INTERVAL_MS = 20;
+
+    /**
+     * The maximum number of changed notes the events are updated in place for. Each update shifts the event arrays,
+     * so past this many notes a full build is faster.
+     */
+    static constexpr size_t MAX_UPDATED_NOTES = 64;
+
+    /**
+     * Guards the pending pattern.
+     */
+    CriticalSection patternLock;
+
+    /**
+     * The pattern to build next. Null if there is nothing to build.
+     */
+    std::shared_ptr<const ArpPattern> pendingPattern;
+
+    /**
+     * The indices of the notes changed in the pending pattern since the last build, sorted and without duplicates.
+     */
+    std::vector<uint64> pendingChanges;
+
+    /**
+     * Whether the pending pattern has to be built from scratch.
+     */
+    bool pendingFullBuild;
+
+    /**
+     * The number of scheduled builds that have not been published yet.
+     */
+    std::atomic<int> numPendingBuilds;
+
+    /**
+     * Signalled every time the worker thread finishes a round of reclaiming and building.
+     */
+    WaitableEvent workDoneEvent;
+
+    /**
+     * The most recently built events, not yet picked up by the audio thread. May be null.
+     */
+    std::atomic<ArpBuiltEvents *> published;
+
+    /**
+     * The events the audio thread has stopped using, waiting for deletion. May be null.
+     */
+    std::atomic<ArpBuiltEvents *> retired;
+
+    /**
+     * The pattern built last. Only accessed by the worker thread.
+     */
+    std::shared_ptr<const ArpPattern> builtPattern;
+
+    /**
+     * The events built last, kept by the worker thread to be updated in place by the next build. Only accessed by the
+     * worker thread.
+     */
+    std::unique_ptr<ArpBuiltEvents> builtEvents;
+
+    /**
+     * Builds the events of large patterns on several threads. Only used by the worker thread.
+     */
+    ArpParallelBuilder parallelBuilder;
+
+
+
+    void run() override;
+
+    /**
+     * Builds the specified pattern, updating the events built last in place if possible.
+     *
+     * @param pattern the pattern to build
+     * @param changes the indices of the notes changed since the last build
+     * @param fullBuild whether the pattern has to be built from scratch
+     */
+    void build(std::shared_ptr<const ArpPattern> pattern, const std::vector<uint64> &changes, bool fullBuild);
+
+    /**
+     * Deletes the retired events, if any.
+     */
+    void reclaim();
+
+    JUCE_DECLARE_NON_COPYABLE(ArpPatternCompiler);
+};
@@ -0,0 +1,542 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <cstring>
+#include <limits>
+#include "ArpPatternParser.h"
+#include "exception/ArpIntegrityException.h"
+
+const int MAX_SKIPPED_DEPTH = 256;
+
+/**
+ * Checks whether a character is XML whitespace.
+ */
+static bool isWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/**
+ * Checks whether a character may appear in an XML name, past its first character.
+ */
+static bool isNameCharacter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+            || c == '_' || c == ':' || c == '-' || c == '.' || (c & 0x80) != 0;
+}
+
+
+ArpPatternParser::ArpPatternParser(const String &xml) : xml(xml) {
+    this->start = this->xml.toRawUTF8();
+    this->end = this->start + this->xml.getNumBytesAsUTF8();
+    this->position = this->start;
+    this->skippedDepth = 0;
+}
+
+
+ArpPattern ArpPatternParser::parse() {
+    this->position = this->start;
+    this->skippedDepth = 0;
+
+    skipMisc(true);
+    auto at = position;
+    expect('<');
+    auto name = readName();
+    if (!name.equals(ArpPattern::TREEID_PATTERN)) {
+        fail(at, "Expected a pattern element");
+    }
+
+    auto result = readPattern(name);
+
+    skipMisc(true);
+    if (position != end) {
+        fail(position, "Unexpected content after the pattern element");
+    }
+
+    return result;
+}
+
+ArpPattern ArpPatternParser::parseState(const Identifier &rootName, ValueTree &settings) {
+    this->position = this->start;
+    this->skippedDepth = 0;
+
+    skipMisc(true);
+    auto at = position;
+    expect('<');
+    auto name = readName();
+    if (!name.equals(rootName)) {
+        fail(at, "Expected a " + rootName.toString().toStdString() + " element");
+    }
+
+    auto isEmpty = readAttributes([&](const Range &attribute, const Range &value) {
+        settings.setProperty(attribute.toIdentifier(), decodeText(value), nullptr);
+    });
+
+    // Only the first pattern element counts, like in ValueTree::getChildWithName
+    bool hasPattern = false;
+    ArpPattern result = ArpPattern();
+    if (!isEmpty) {
+        readContent(name, [&](const Range &child) {
+            if (!hasPattern && child.equals(ArpPattern::TREEID_PATTERN)) {
+                hasPattern = true;
+                result = readPattern(child);
+            } else {
+                settings.appendChild(readSettingsElement(child), nullptr);
+            }
+        });
+    }
+    if (!hasPattern) {
+        fail(at, "Missing pattern element");
+    }
+
+    skipMisc(true);
+    if (position != end) {
+        fail(position, "Unexpected content after the state element");
+    }
+
+    return result;
+}
+
+
+bool ArpPatternParser::Range::equals(const Identifier &name) const {
+    const auto &text = name.toString();
+    auto length = text.getNumBytesAsUTF8();
+    return static_cast<size_t>(this->end - this->begin) == length
+            && std::memcmp(this->begin, text.toRawUTF8(), length) == 0;
+}
+
+Identifier ArpPatternParser::Range::toIdentifier() const {
+    return Identifier(String::fromUTF8(this->begin, static_cast<int>(this->end - this->begin)));
+}
+
+
+ArpPattern ArpPatternParser::readPattern(const Range &name) {
+    int timebase = ArpPattern::DEFAULT_TIMEBASE;
+    bool hasLoopLength = false;
+    int64 loopLength = 0;
+    auto isEmpty = readAttributes([&](const Range &attribute, const Range &value) {
+        if (attribute.equals(ArpPattern::TREEID_TIMEBASE)) {
+            timebase = static_cast<int>(parseInteger(value, 1, std::numeric_limits<int>::max()));
+        } else if (attribute.equals(ArpPattern::TREEID_LOOP_LENGTH)) {
+            loopLength = parseInteger(value, 1, std::numeric_limits<int64>::max());
+            hasLoopLength = true;
+        }
+    });
+
+    ArpPattern result = ArpPattern(timebase);
+    if (hasLoopLength) {
+        result.loopLength = loopLength;
+    }
+
+    if (!isEmpty) {
+        // Only the first notes element counts, like in ArpPattern::fromValueTree
+        bool hasNotes = false;
+        readContent(name, [&](const Range &child) {
+            if (!hasNotes && child.equals(ArpPattern::TREEID_NOTES)) {
+                hasNotes = true;
+                result.getNotes().reserve(countNotes());
+                readNotes(child, result.getNotes());
+            } else {
+                skipElement(child);
+            }
+        });
+    }
+
+    return result;
+}
+
+
+void ArpPatternParser::skipMisc(bool isTopLevel) {
+    while (position != end) {
+        if (*position != '<') {
+            if (!isTopLevel || isWhitespace(*position)) {
+                position++;
+                continue;
+            }
+            fail(position, "Unexpected text outside of the pattern element");
+        }
+
+        auto remaining = static_cast<size_t>(end - position);
+        if (remaining >= 4 && std::memcmp(position, "<!--", 4) == 0) {
+            skipPast("-->", "comment");
+        } else if (remaining >= 2 && std::memcmp(position, "<?", 2) == 0) {
+            skipPast("?>", "processing instruction");
+        } else if (!isTopLevel && remaining >= 9 && std::memcmp(position, "<![CDATA[", 9) == 0) {
+            skipPast("]]>", "CDATA section");
+        } else if (isTopLevel && remaining >= 2 && std::memcmp(position, "<!", 2) == 0) {
+            skipPast(">", "document type declaration");
+        } else {
+            return;
+        }
+    }
+}
+
+void ArpPatternParser::skipPast(const char *terminator, const char *what) {
+    auto at = position;
+    auto length = std::strlen(terminator);
+    for (auto p = position; p + length <= end; p++) {
+        if (std::memcmp(p, terminator, length) == 0) {
+            position = p + length;
+            return;
+        }
+    }
+    fail(at, std::string("Unterminated ") + what);
+}
+
+void ArpPatternParser::skipWhitespace() {
+    while (position != end && isWhitespace(*position)) {
+        position++;
+    }
+}
+
+void ArpPatternParser::expect(char c) {
+    if (position == end) {
+        fail(position, std::string("Expected '") + c + "' but found the end of the input");
+    }
+    if (*position != c) {
+        fail(position, std::string("Expected '") + c + "'");
+    }
+    position++;
+}
+
+ArpPatternParser::Range ArpPatternParser::readName() {
+    auto begin = position;
+    if (position == end || !isNameCharacter(*position) || (*position >= '0' && *position <= '9')
+            || *position == '-' || *position == '.') {
+        fail(position, "Expected a name");
+    }
+
+    while (position != end && isNameCharacter(*position)) {
+        position++;
+    }
+    return Range { begin, position };
+}
+
+template <typename Function>
+bool ArpPatternParser::readAttributes(Function &&onAttribute) {
+    while (true) {
+        auto hasWhitespace = position != end && isWhitespace(*position);
+        skipWhitespace();
+        if (position == end) {
+            fail(position, "Unterminated tag");
+        }
+
+        if (*position == '>') {
+            position++;
+            return false;
+        }
+        if (*position == '/') {
+            position++;
+            expect('>');
+            return true;
+        }
+        if (!hasWhitespace) {
+            fail(position, "Expected whitespace before an attribute");
+        }
+
+        auto name = readName();
+        skipWhitespace();
+        expect('=');
+        skipWhitespace();
+
+        if (position == end || (*position != '"' && *position != '\'')) {
+            fail(position, "Expected a quoted attribute value");
+        }
+        auto quote = *position++;
+        auto valueEnd = static_cast<const char *>(std::memchr(position, quote, static_cast<size_t>(end - position)));
+        if (valueEnd == nullptr) {
+            fail(position - 1, "Unterminated attribute value");
+        }
+
+        onAttribute(name, Range { position, valueEnd });
+        position = valueEnd + 1;
+    }
+}
+
+template <typename Function>
+void ArpPatternParser::readContent(const Range &name, Function &&onChild) {
+    while (true) {
+        skipMisc(false);
+        if (position == end) {
+            fail(name.begin - 1, "Unclosed element");
+        }
+
+        auto at = position;
+        if (end - position >= 2 && position[1] == '/') {
+            position += 2;
+            auto endName = readName();
+            if (endName.end - endName.begin != name.end - name.begin
+                    || std::memcmp(endName.begin, name.begin, static_cast<size_t>(name.end - name.begin)) != 0) {
+                fail(at, "Mismatched end tag");
+            }
+            skipWhitespace();
+            expect('>');
+            return;
+        }
+
+        position++;
+        onChild(readName());
+    }
+}
+
+void ArpPatternParser::skipElement(const Range &name) {
+    if (readAttributes([](const Range &, const Range &) {})) {
+        return;
+    }
+
+    // Skipped and settings elements are the only ones that can nest arbitrarily, so they bound the recursion
+    if (skippedDepth >= MAX_SKIPPED_DEPTH) {
+        fail(name.begin - 1, "Elements nested too deeply");
+    }
+    skippedDepth++;
+    readContent(name, [this](const Range &child) {
+        skipElement(child);
+    });
+    skippedDepth--;
+}
+
+ValueTree ArpPatternParser::readSettingsElement(const Range &name) {
+    ValueTree result = ValueTree(name.toIdentifier());
+    auto isEmpty = readAttributes([&](const Range &attribute, const Range &value) {
+        result.setProperty(attribute.toIdentifier(), decodeText(value), nullptr);
+    });
+    if (isEmpty) {
+        return result;
+    }
+
+    if (skippedDepth >= MAX_SKIPPED_DEPTH) {
+        fail(name.begin - 1, "Elements nested too deeply");
+    }
+    skippedDepth++;
+    readContent(name, [&](const Range &child) {
+        result.appendChild(readSettingsElement(child), nullptr);
+    });
+    skippedDepth--;
+
+    return result;
+}
+
+void ArpPatternParser::readNotes(const Range &name, std::vector<ArpNote> &notes) {
+    if (readAttributes([](const Range &, const Range &) {})) {
+        return;
+    }
+
+    readContent(name, [&](const Range &child) {
+        if (!child.equals(ArpNote::TREEID_NOTE)) {
+            fail(child.begin - 1, "Expected a note element");
+        }
+        notes.push_back(readNote(child));
+    });
+}
+
+ArpNote ArpPatternParser::readNote(const Range &name) {
+    ArpNote note = ArpNote();
+    auto isEmpty = readAttributes([&](const Range &attribute, const Range &value) {
+        if (attribute.equals(ArpNote::TREEID_START_POINT)) {
+            note.startPoint = parseInteger(value, std::numeric_limits<int64>::min(), std::numeric_limits<int64>::max());
+        } else if (attribute.equals(ArpNote::TREEID_END_POINT)) {
+            note.endPoint = parseInteger(value, std::numeric_limits<int64>::min(), std::numeric_limits<int64>::max());
+        }
+    });
+
+    if (!isEmpty) {
+        bool hasData = false;
+        readContent(name, [&](const Range &child) {
+            if (!hasData && child.equals(NoteData::TREEID_NOTE_DATA)) {
+                hasData = true;
+                readNoteData(child, note.data);
+            } else {
+                skipElement(child);
+            }
+        });
+    }
+
+    return note;
+}
+
+void ArpPatternParser::readNoteData(const Range &name, NoteData &data) {
+    auto isEmpty = readAttributes([&](const Range &attribute, const Range &value) {
+        if (attribute.equals(NoteData::TREEID_NOTE_NUMBER)) {
+            data.noteNumber = static_cast<int>(
+                    parseInteger(value, std::numeric_limits<int>::min(), std::numeric_limits<int>::max()));
+        } else if (attribute.equals(NoteData::TREEID_VELOCITY)) {
+            data.velocity = parseDouble(value);
+        } else if (attribute.equals(NoteData::TREEID_PAN)) {
+            data.pan = parseDouble(value);
+        }
+    });
+
+    if (!isEmpty) {
+        readContent(name, [this](const Range &child) {
+            skipElement(child);
+        });
+    }
+}
+
+
+size_t ArpPatternParser::countNotes() const {
+    const auto &tag = ArpNote::TREEID_NOTE.toString();
+    auto length = tag.getNumBytesAsUTF8();
+
+    size_t count = 0;
+    for (auto p = start; p != end; p++) {
+        p = static_cast<const char *>(std::memchr(p, '<', static_cast<size_t>(end - p)));
+        if (p == nullptr) {
+            break;
+        }
+
+        auto next = p + 1 + length;
+        if (next < end && std::memcmp(p + 1, tag.toRawUTF8(), length) == 0
+                && (isWhitespace(*next) || *next == '/' || *next == '>')) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int64 ArpPatternParser::parseInteger(const Range &value, int64 min, int64 max) {
+    auto p = value.begin;
+    auto isNegative = p != value.end && *p == '-';
+    if (p != value.end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+    if (p == value.end) {
+        fail(value.begin, "Expected an integer");
+    }
+
+    // Accumulated as the magnitude, which may reach one past the maximum of int64 for the minimum
+    uint64 limit = 0;
+    if (isNegative && min < 0) {
+        limit = static_cast<uint64>(-(min + 1)) + 1;
+    } else if (!isNegative && max > 0) {
+        limit = static_cast<uint64>(max);
+    }
+
+    uint64 magnitude = 0;
+    for (; p != value.end; p++) {
+        if (*p < '0' || *p > '9') {
+            fail(p, "Expected an integer");
+        }
+
+        auto digit = static_cast<uint64>(*p - '0');
+        if (digit > limit || magnitude > (limit - digit) / 10) {
+            fail(value.begin, "Integer out of range");
+        }
+        magnitude = magnitude * 10 + digit;
+    }
+
+    auto result = static_cast<int64>(magnitude);
+    if (isNegative && magnitude != 0) {
+        result = -static_cast<int64>(magnitude - 1) - 1;
+    }
+    if (result < min || result > max) {
+        fail(value.begin, "Integer out of range");
+    }
+    return result;
+}
+
+double ArpPatternParser::parseDouble(const Range &value) {
+    if (value.begin == value.end || isWhitespace(*value.begin)) {
+        fail(value.begin, "Expected a number");
+    }
+
+    CharPointer_UTF8 text(value.begin);
+    auto result = CharacterFunctions::readDoubleValue(text);
+    if (text.getAddress() != value.end) {
+        fail(value.begin, "Expected a number");
+    }
+    return result;
+}
+
+String ArpPatternParser::decodeText(const Range &value) {
+    // Most values have no references, and are converted as they are
+    auto length = static_cast<size_t>(value.end - value.begin);
+    auto reference = static_cast<const char *>(std::memchr(value.begin, '&', length));
+    if (reference == nullptr) {
+        return String::fromUTF8(value.begin, static_cast<int>(length));
+    }
+
+    std::string result = std::string(value.begin, reference);
+    for (auto p = reference; p != value.end;) {
+        if (*p != '&') {
+            result += *p++;
+            continue;
+        }
+
+        auto semicolon = static_cast<const char *>(std::memchr(p, ';', static_cast<size_t>(value.end - p)));
+        if (semicolon == nullptr) {
+            fail(p, "Unterminated reference");
+        }
+
+        std::string entity = std::string(p + 1, semicolon);
+        if (entity == "lt") {
+            result += '<';
+        } else if (entity == "gt") {
+            result += '>';
+        } else if (entity == "amp") {
+            result += '&';
+        } else if (entity == "quot") {
+            result += '"';
+        } else if (entity == "apos") {
+            result += '\'';
+        } else if (entity.size() >= 2 && entity[0] == '#') {
+            auto isHex = entity[1] == 'x';
+            auto digits = entity.substr(isHex ? 2 : 1);
+            if (digits.empty() || digits.size() > 8) {
+                fail(p, "Invalid character reference");
+            }
+
+            uint32 code = 0;
+            for (auto c : digits) {
+                uint32 digit;
+                if (c >= '0' && c <= '9') {
+                    digit = static_cast<uint32>(c - '0');
+                } else if (isHex && c >= 'a' && c <= 'f') {
+                    digit = static_cast<uint32>(c - 'a' + 10);
+                } else if (isHex && c >= 'A' && c <= 'F') {
+                    digit = static_cast<uint32>(c - 'A' + 10);
+                } else {
+                    fail(p, "Invalid character reference");
+                }
+                code = code * (isHex ? 16 : 10) + digit;
+            }
+            if (code == 0 || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) {
+                fail(p, "Invalid character reference");
+            }
+            result += String::charToString(static_cast<juce_wchar>(code)).toStdString();
+        } else {
+            fail(p, "Unknown entity reference");
+        }
+        p = semicolon + 1;
+    }
+
+    return String::fromUTF8(result.data(), static_cast<int>(result.size()));
+}
+
+void ArpPatternParser::fail(const char *at, const std::string &message) const {
+    int line = 1;
+    int column = 1;
+    for (auto p = start; p != at; p++) {
+        if (*p == '\n') {
+            line++;
+            column = 1;
+        } else if ((*p & 0xC0) != 0x80) {
+            // Continuation bytes belong to the character they continue
+            column++;
+        }
+    }
+
+    throw ArpIntegrityException(message, line, column);
+}
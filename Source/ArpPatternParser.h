@@ -0,0 +1,274 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <vector>
+#include "JuceHeader.h"
+#include "ArpPattern.h"
+
+/**
+ * A streaming parser of pattern XML, as written by ArpPattern::toValueTree and ValueTree::toXmlString.
+ *
+ * The text is tokenized in a single pass and the notes are written straight into the pattern, without building an
+ * XML document or value trees in between. Elements and attributes that the pattern does not use are skipped, and
+ * missing attributes take the same defaults as in ArpPattern::fromValueTree.
+ *
+ * The parser also reads the legacy XML state, whose root element holds the settings as attributes and the pattern as
+ * a child element. Only the settings end up in a value tree; the pattern is read the same way as on its own.
+ */
+class ArpPatternParser {
+public:
+
+    /**
+     * Constructs a parser of the specified XML.
+     *
+     * @param xml the XML to parse
+     */
+    explicit ArpPatternParser(const String &xml);
+
+
+
+    /**
+     * Parses the XML into the pattern it represents.
+     *
+     * @return the pattern represented by the XML
+     * @throws ArpIntegrityException if the XML is malformed or does not represent a pattern, with the line and
+     * column of the error
+     */
+    ArpPattern parse();
+
+    /**
+     * Parses the XML as a state element holding a pattern. The attributes and the children other than the pattern are
+     * added to the settings tree, like ValueTree::fromXml would.
+     *
+     * @param rootName the expected name of the state element
+     * @param settings the tree to add the settings to
+     * @return the pattern held by the state
+     * @throws ArpIntegrityException if the XML is malformed or does not represent a state holding a pattern, with
+     * the line and column of the error
+     */
+    ArpPattern parseState(const Identifier &rootName, ValueTree &settings);
+
+private:
+
+    /**
+     * A range of the parsed text.
+     */
+    class Range {
+    public:
+
+        /**
+         * The start of the range.
+         */
+        const char *begin;
+
+        /**
+         * The end of the range, exclusive.
+         */
+        const char *end;
+
+        /**
+         * Checks whether the range holds exactly the specified name.
+         *
+         * @param name the name to compare with
+         * @return true if the range holds the name
+         */
+        bool equals(const Identifier &name) const;
+
+        /**
+         * Converts the range to an identifier.
+         *
+         * @return the identifier
+         */
+        Identifier toIdentifier() const;
+    };
+
+    /**
+     * The XML to parse, kept to keep the text alive.
+     */
+    String xml;
+
+    /**
+     * The start of the text.
+     */
+    const char *start;
+
+    /**
+     * The end of the text.
+     */
+    const char *end;
+
+    /**
+     * The current position in the text.
+     */
+    const char *position;
+
+    /**
+     * The number of skipped or settings elements that are open.
+     */
+    int skippedDepth;
+
+
+
+    /**
+     * Skips whitespace, comments, processing instructions, document type declarations and, unless at the top level,
+     * text and CDATA sections, up to the next tag.
+     *
+     * @param isTopLevel whether the position is outside the root element
+     */
+    void skipMisc(bool isTopLevel);
+
+    /**
+     * Skips past the specified terminator.
+     *
+     * @param terminator the text that ends what is skipped
+     * @param what the description of what is skipped, for the error message
+     */
+    void skipPast(const char *terminator, const char *what);
+
+    /**
+     * Skips whitespace.
+     */
+    void skipWhitespace();
+
+    /**
+     * Consumes the specified character.
+     *
+     * @param c the character to consume
+     * @throws ArpIntegrityException if the text does not continue with the character
+     */
+    void expect(char c);
+
+    /**
+     * Reads an element or attribute name.
+     *
+     * @return the name
+     * @throws ArpIntegrityException if there is no name at the position
+     */
+    Range readName();
+
+    /**
+     * Reads the attributes of the element whose name has just been read, up to the end of its start tag.
+     *
+     * @param onAttribute the function called as onAttribute(name, value) for every attribute
+     * @return true if the element is empty, i.e. its start tag is also its end tag
+     */
+    template <typename Function>
+    bool readAttributes(Function &&onAttribute);
+
+    /**
+     * Reads the content of the element whose start tag has just been read, up to and including its end tag.
+     *
+     * @param name the name of the element
+     * @param onChild the function called as onChild(name) for every child element after its name has been read,
+     * which must consume the rest of the child element
+     */
+    template <typename Function>
+    void readContent(const Range &name, Function &&onChild);
+
+    /**
+     * Skips the rest of the element whose name has just been read.
+     *
+     * @param name the name of the element
+     */
+    void skipElement(const Range &name);
+
+    /**
+     * Reads the rest of the pattern element whose name has just been read.
+     *
+     * @param name the name of the element
+     * @return the pattern
+     */
+    ArpPattern readPattern(const Range &name);
+
+    /**
+     * Reads the rest of the settings element whose name has just been read, with its attributes and children.
+     *
+     * @param name the name of the element
+     * @return the element as a value tree
+     */
+    ValueTree readSettingsElement(const Range &name);
+
+    /**
+     * Reads the rest of the notes element whose name has just been read.
+     *
+     * @param name the name of the element
+     * @param notes the vector to add the notes to
+     */
+    void readNotes(const Range &name, std::vector<ArpNote> &notes);
+
+    /**
+     * Reads the rest of the note element whose name has just been read.
+     *
+     * @param name the name of the element
+     * @return the note
+     */
+    ArpNote readNote(const Range &name);
+
+    /**
+     * Reads the rest of the note data element whose name has just been read.
+     *
+     * @param name the name of the element
+     * @param data the note data to set the attributes of
+     */
+    void readNoteData(const Range &name, NoteData &data);
+
+    /**
+     * Counts the note start tags in the text, at least as many as there are notes to read.
+     *
+     * @return the number of note start tags
+     */
+    size_t countNotes() const;
+
+    /**
+     * Parses an integer attribute value.
+     *
+     * @param value the attribute value
+     * @param min the minimum valid value
+     * @param max the maximum valid value
+     * @return the integer
+     * @throws ArpIntegrityException if the value is not an integer in the valid range
+     */
+    int64 parseInteger(const Range &value, int64 min, int64 max);
+
+    /**
+     * Parses a decimal attribute value.
+     *
+     * @param value the attribute value
+     * @return the number
+     * @throws ArpIntegrityException if the value is not a number
+     */
+    double parseDouble(const Range &value);
+
+    /**
+     * Decodes the entity and character references of an attribute value.
+     *
+     * @param value the attribute value
+     * @return the decoded text
+     * @throws ArpIntegrityException if a reference is unterminated, unknown or not a valid character
+     */
+    String decodeText(const Range &value);
+
+    /**
+     * Throws an exception with the line and column of the specified position.
+     *
+     * @param at the position of the error
+     * @param message the description of the error
+     */
+    [[noreturn]] void fail(const char *at, const std::string &message) const;
+};
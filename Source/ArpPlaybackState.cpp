@@ -0,0 +1,56 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+#include "ArpPlaybackState.h"
+
+bool ArpPlaybackState::Snapshot::isNotePlaying(unsigned long noteIndex) const {
+    return std::binary_search(
+            this->playingNoteIndices,
+            this->playingNoteIndices + this->numPlayingNotes,
+            static_cast<uint32>(noteIndex));
+}
+
+
+ArpPlaybackState::ArpPlaybackState() : middle(1) {
+    this->back = 0;
+    this->front = 2;
+    this->version = 0;
+}
+
+
+ArpPlaybackState::Snapshot &ArpPlaybackState::getBack() {
+    return this->buffers[this->back];
+}
+
+void ArpPlaybackState::publish() {
+    auto &snapshot = this->buffers[this->back];
+    snapshot.version = ++this->version;
+
+    auto previous = this->middle.exchange(this->back | FRESH);
+    this->back = previous & INDEX_MASK;
+}
+
+const ArpPlaybackState::Snapshot &ArpPlaybackState::read() {
+    if ((this->middle.load() & FRESH) != 0) {
+        this->front = this->middle.exchange(this->front) & INDEX_MASK;
+
+        auto &snapshot = this->buffers[this->front];
+        std::sort(snapshot.playingNoteIndices, snapshot.playingNoteIndices + snapshot.numPlayingNotes);
+    }
+    return this->buffers[this->front];
+}
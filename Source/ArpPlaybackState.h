@@ -0,0 +1,155 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <atomic>
+#include "JuceHeader.h"
+#include "ArpVoiceTable.h"
+
+/**
+ * The playback state the audio thread shares with the editor.
+ *
+ * The state is triple-buffered: the audio thread fills the back snapshot and publishes it by exchanging it with the
+ * middle one, the editor picks up the middle one by exchanging it with the front one. Neither side ever blocks or
+ * allocates, and each snapshot is only ever accessed by one thread at a time.
+ */
+class ArpPlaybackState {
+public:
+
+    /**
+     * A snapshot of the playback state.
+     */
+    class Snapshot {
+    public:
+
+        /**
+         * The version of the snapshot, incremented on every publish.
+         */
+        uint64 version = 0;
+
+        /**
+         * The last position the processor has played, in pulses. Zero when stopped.
+         */
+        int64 position = 0;
+
+        /**
+         * The last active number of input notes.
+         */
+        int numInputNotes = 0;
+
+        /**
+         * The time signature numerator.
+         */
+        int timeSigNumerator = 4;
+
+        /**
+         * The time signature denominator.
+         */
+        int timeSigDenominator = 4;
+
+        /**
+         * The number of valid entries in playingNoteIndices.
+         */
+        int numPlayingNotes = 0;
+
+        /**
+         * The indices of the pattern notes currently playing. Sorted in ascending order once picked up by the reader.
+         */
+        uint32 playingNoteIndices[ArpVoiceTable::MAX_VOICES];
+
+
+
+        /**
+         * Checks whether the pattern note at the specified index is playing. Only to be used on a snapshot obtained
+         * from ArpPlaybackState::read.
+         *
+         * @param noteIndex the index of the note in the pattern
+         * @return true if the note is playing
+         */
+        bool isNotePlaying(unsigned long noteIndex) const;
+    };
+
+
+
+    /**
+     * Constructs the playback state with empty snapshots.
+     */
+    ArpPlaybackState();
+
+
+
+    /**
+     * Gets the back snapshot to fill in. Its contents are stale, so all the fields have to be written before
+     * publishing. To be called from the audio thread only.
+     *
+     * @return the back snapshot
+     */
+    Snapshot &getBack();
+
+    /**
+     * Publishes the back snapshot with a new version. To be called from the audio thread only.
+     */
+    void publish();
+
+    /**
+     * Gets the most recently published snapshot. To be called from a single reader thread only; the returned snapshot
+     * stays valid until the next call.
+     *
+     * @return the most recently published snapshot
+     */
+    const Snapshot &read();
+
+private:
+
+    /**
+     * Flag of the middle index marking a snapshot that has not been picked up by the reader yet.
+     */
+    static constexpr int FRESH = 4;
+
+    /**
+     * Mask of the middle index holding the buffer index.
+     */
+    static constexpr int INDEX_MASK = 3;
+
+    /**
+     * The three snapshot buffers.
+     */
+    Snapshot buffers[3];
+
+    /**
+     * The index of the snapshot owned by the writer.
+     */
+    int back;
+
+    /**
+     * The index of the snapshot in exchange between the threads, possibly flagged as FRESH.
+     */
+    std::atomic<int> middle;
+
+    /**
+     * The index of the snapshot owned by the reader.
+     */
+    int front;
+
+    /**
+     * The version of the last published snapshot.
+     */
+    uint64 version;
+
+    JUCE_DECLARE_NON_COPYABLE(ArpPlaybackState);
+};
@@ -0,0 +1,76 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <limits>
+#include "ArpScheduler.h"
+
+/**
+ * Calculates the modulo of the dividend, rounded towards negative infinity.
+ */
+static int64 floorMod(int64 dividend, int64 divisor) {
+    auto result = dividend % divisor;
+    return (result < 0) ? result + divisor : result;
+}
+
+
+ArpScheduler::ArpScheduler() {
+    this->valid = false;
+    this->seekedResetLength = 0;
+    this->position = 0;
+    this->cursor = 0;
+    this->loopStart = 0;
+    this->loopEnd = 0;
+    this->resetEnd = 0;
+}
+
+
+void ArpScheduler::reset() {
+    this->valid = false;
+}
+
+bool ArpScheduler::isValid() const {
+    return this->valid;
+}
+
+int64 ArpScheduler::getPatternTime() const {
+    return this->position - this->loopStart;
+}
+
+
+void ArpScheduler::seek(ArpBuiltEvents &events, int64 resetLength, int64 newPosition) {
+    auto loopLength = events.loopLength;
+
+    int64 resetStart;
+    if (resetLength > 0) {
+        resetStart = newPosition - floorMod(newPosition, resetLength);
+        this->resetEnd = resetStart + resetLength;
+    } else {
+        resetStart = 0;
+        this->resetEnd = std::numeric_limits<int64>::max();
+    }
+
+    this->loopStart = newPosition - floorMod(newPosition - resetStart, loopLength);
+    this->loopEnd = jmin(this->loopStart + loopLength, this->resetEnd);
+
+    auto patternTime = newPosition - this->loopStart;
+    auto it = std::lower_bound(events.times.begin(), events.times.end(), patternTime);
+    this->cursor = static_cast<size_t>(it - events.times.begin());
+
+    this->position = newPosition;
+    this->seekedResetLength = resetLength;
+    this->valid = true;
+}
@@ -0,0 +1,223 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "ArpBuiltEvents.h"
+
+/**
+ * Finds the built events due in consecutive windows of playback.
+ *
+ * The scheduler keeps a read cursor into the time-sorted events of the pattern, together with the absolute position of
+ * the loop iteration it is in. When the windows are contiguous, each call only walks across the events due in the
+ * window and the loop and reset boundaries inside it, so its cost does not depend on the size of the pattern. When
+ * the playhead jumps, the cursor is re-seeked by a binary search.
+ *
+ * The pattern loops every loopLength pulses. If a reset length is set, the pattern is also restarted every that many
+ * pulses, cutting the last loop iteration short.
+ */
+class ArpScheduler {
+public:
+
+    /**
+     * Constructs a scheduler with an invalid cursor.
+     */
+    ArpScheduler();
+
+
+
+    /**
+     * Invalidates the cursor, so that the next window is seeked from scratch. Must be called whenever the scheduled
+     * events are replaced.
+     */
+    void reset();
+
+    /**
+     * Checks whether the cursor is valid, that is, whether it has scheduled a window since the last reset.
+     *
+     * @return true if the cursor is valid
+     */
+    bool isValid() const;
+
+    /**
+     * Gets the position the next window continues from, relative to the start of its loop iteration. Only meaningful
+     * if the cursor is valid.
+     *
+     * @return the position within the current loop iteration, in pulses
+     */
+    int64 getPatternTime() const;
+
+    /**
+     * Calls the callback for each event due in the specified window, in time order.
+     *
+     * If the window overlaps the end of the previously scheduled one, only the part after it is scheduled, so no event
+     * is reported twice. Otherwise the playhead is considered to have jumped and the cursor is re-seeked to the start
+     * of the window.
+     *
+     * The reset mode is a template parameter, so that the loop boundary handling of the mode not in use is compiled
+     * out.
+     *
+     * @tparam Reset whether the pattern restarts every resetLength pulses
+     * @param events the built events
+     * @param resetLength the amount of pulses after which the pattern restarts; must be zero if Reset is false
+     * @param from the start of the window in pulses (inclusive)
+     * @param to the end of the window in pulses (exclusive)
+     * @param onEvent the function called as onEvent(eventIndex, time) for every due event, time being the absolute
+     * position of the event in pulses
+     * @param onLoopStart the function called as onLoopStart(time) at the start of every loop iteration within the
+     * window, before the events of the iteration
+     * @param onChase the function called as onChase(patternTime, time) when the cursor is re-seeked into the middle of
+     * a loop iteration, before the events of the window, patternTime being the position within the iteration
+     */
+    template <bool Reset, typename EventCallback, typename LoopStartCallback, typename ChaseCallback>
+    void schedule(
+            ArpBuiltEvents &events,
+            int64 resetLength,
+            int64 from,
+            int64 to,
+            EventCallback &&onEvent,
+            LoopStartCallback &&onLoopStart,
+            ChaseCallback &&onChase);
+
+private:
+
+    /**
+     * Whether the cursor is valid.
+     */
+    bool valid;
+
+    /**
+     * The reset length the cursor was positioned with.
+     */
+    int64 seekedResetLength;
+
+    /**
+     * The end of the last scheduled window, in pulses. The cursor points to the first event at or after it.
+     */
+    int64 position;
+
+    /**
+     * The index of the next event to fire in the current loop iteration.
+     */
+    size_t cursor;
+
+    /**
+     * The absolute start of the current loop iteration, in pulses.
+     */
+    int64 loopStart;
+
+    /**
+     * The absolute end of the current loop iteration, in pulses. Shorter than the loop length if cut by a reset.
+     */
+    int64 loopEnd;
+
+    /**
+     * The absolute end of the current reset period, in pulses.
+     */
+    int64 resetEnd;
+
+
+
+    /**
+     * Positions the cursor to the first event at or after the specified position.
+     *
+     * @param events the built events
+     * @param resetLength the amount of pulses after which the pattern restarts, zero for no reset
+     * @param newPosition the position to seek to, in pulses
+     */
+    void seek(ArpBuiltEvents &events, int64 resetLength, int64 newPosition);
+
+    /**
+     * Moves the cursor to the start of the following loop iteration.
+     *
+     * @tparam Reset whether the pattern restarts every seekedResetLength pulses
+     * @param events the built events
+     */
+    template <bool Reset>
+    void nextLoop(ArpBuiltEvents &events);
+};
+
+
+
+template <bool Reset, typename EventCallback, typename LoopStartCallback, typename ChaseCallback>
+void ArpScheduler::schedule(
+        ArpBuiltEvents &events,
+        int64 resetLength,
+        int64 from,
+        int64 to,
+        EventCallback &&onEvent,
+        LoopStartCallback &&onLoopStart,
+        ChaseCallback &&onChase) {
+    jassert(Reset || resetLength == 0);
+    if (events.loopLength <= 0) {
+        return;
+    }
+
+    bool continuous = valid
+            && seekedResetLength == resetLength
+            && from <= position
+            && position <= to;
+
+    if (!continuous) {
+        seek(events, resetLength, from);
+        if (position == loopStart) {
+            onLoopStart(loopStart);
+        } else {
+            onChase(position - loopStart, position);
+        }
+    }
+
+    auto numEvents = events.times.size();
+    while (true) {
+        if (cursor < numEvents) {
+            auto time = loopStart + events.times[cursor];
+            if (time < loopEnd) {
+                if (time >= to) {
+                    break;
+                }
+
+                onEvent(cursor, time);
+                cursor++;
+                continue;
+            }
+        }
+
+        if (loopEnd >= to) {
+            break;
+        }
+
+        nextLoop<Reset>(events);
+        onLoopStart(loopStart);
+    }
+
+    position = to;
+}
+
+template <bool Reset>
+void ArpScheduler::nextLoop(ArpBuiltEvents &events) {
+    this->loopStart = this->loopEnd;
+    if (Reset) {
+        if (this->loopStart >= this->resetEnd) {
+            this->resetEnd += this->seekedResetLength;
+        }
+        this->loopEnd = jmin(this->loopStart + events.loopLength, this->resetEnd);
+    } else {
+        this->loopEnd = this->loopStart + events.loopLength;
+    }
+    this->cursor = 0;
+}
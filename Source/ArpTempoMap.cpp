@@ -0,0 +1,129 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "ArpTempoMap.h"
+#include "ArpPattern.h"
+
+const double DEFAULT_SAMPLE_RATE = 44100.0;
+const double SECONDS_PER_MINUTE = 60.0;
+const double DEFAULT_BPM = 120.0;
+
+ArpTempoMap::ArpTempoMap() {
+    this->sampleRate = DEFAULT_SAMPLE_RATE;
+    this->timebase = ArpPattern::DEFAULT_TIMEBASE;
+    this->bpmPulseSamples = SECONDS_PER_MINUTE * this->sampleRate / this->timebase;
+    begin(0.0, 0, getPulseSamples(DEFAULT_BPM));
+}
+
+
+void ArpTempoMap::prepare(double sampleRate) {
+    this->sampleRate = sampleRate;
+    this->bpmPulseSamples = SECONDS_PER_MINUTE * this->sampleRate / this->timebase;
+}
+
+void ArpTempoMap::setTimebase(int timebase) {
+    jassert(timebase > 0);
+    this->timebase = timebase;
+    this->bpmPulseSamples = SECONDS_PER_MINUTE * this->sampleRate / this->timebase;
+}
+
+double ArpTempoMap::getPulseSamples(double bpm) const {
+    return this->bpmPulseSamples / bpm;
+}
+
+
+void ArpTempoMap::begin(double originPulse, int64 originOffset, double pulseSamples) {
+    this->segments[0].startOffset = originOffset;
+    this->segments[0].startPulse = originPulse;
+    this->segments[0].pulseSamples = pulseSamples;
+    this->numSegments = 1;
+}
+
+void ArpTempoMap::changeTempo(int64 offset, double pulseSamples) {
+    auto &last = this->segments[this->numSegments - 1];
+    jassert(offset >= last.startOffset);
+    if (pulseSamples == last.pulseSamples || this->numSegments >= MAX_SEGMENTS) {
+        return;
+    }
+
+    auto startPulse = getPulse(offset);
+    if (offset == last.startOffset) {
+        last.pulseSamples = pulseSamples;
+        return;
+    }
+
+    auto &segment = this->segments[this->numSegments++];
+    segment.startOffset = offset;
+    segment.startPulse = startPulse;
+    segment.pulseSamples = pulseSamples;
+}
+
+int ArpTempoMap::getNumSegments() const {
+    return this->numSegments;
+}
+
+const ArpTempoMap::Segment &ArpTempoMap::getLastSegment() const {
+    return this->segments[this->numSegments - 1];
+}
+
+
+double ArpTempoMap::getPulse(int64 offset) const {
+    auto &segment = findByOffset(offset);
+    return segment.startPulse + (offset - segment.startOffset) / segment.pulseSamples;
+}
+
+int64 ArpTempoMap::getOffset(int64 time) const {
+    auto &segment = findByPulse(time);
+    return segment.startOffset + static_cast<int64>(std::floor((time - segment.startPulse) * segment.pulseSamples));
+}
+
+int64 ArpTempoMap::getFirstPulse(int64 offset) const {
+    // The estimate can be off by one either way because of rounding, the offsets themselves decide
+    auto pulse = static_cast<int64>(std::ceil(getPulse(offset)));
+    while (getOffset(pulse - 1) >= offset) {
+        pulse--;
+    }
+    while (getOffset(pulse) < offset) {
+        pulse++;
+    }
+    return pulse;
+}
+
+
+const ArpTempoMap::Segment &ArpTempoMap::findByOffset(int64 offset) const {
+    if (this->numSegments == 1) {
+        return this->segments[0];
+    }
+
+    auto end = this->segments + this->numSegments;
+    auto it = std::upper_bound(this->segments + 1, end, offset, [](int64 value, const Segment &segment) {
+        return value < segment.startOffset;
+    });
+    return *(it - 1);
+}
+
+const ArpTempoMap::Segment &ArpTempoMap::findByPulse(int64 time) const {
+    if (this->numSegments == 1) {
+        return this->segments[0];
+    }
+
+    auto end = this->segments + this->numSegments;
+    auto it = std::upper_bound(this->segments + 1, end, time, [](int64 value, const Segment &segment) {
+        return value < segment.startPulse;
+    });
+    return *(it - 1);
+}
@@ -0,0 +1,195 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include "JuceHeader.h"
+
+/**
+ * Maps pulses to sample offsets within a block whose tempo may change.
+ *
+ * The block is split into segments of constant tempo. Each segment starts at a sample offset and at the fractional
+ * pulse the previous segment reaches there, so the position is the piecewise integral of the tempo over the block.
+ * The sample rate and the timebase the conversions depend on are cached when they change, not for every block. With
+ * a constant tempo there is a single segment and every conversion is a single multiplication.
+ */
+class ArpTempoMap {
+public:
+
+    /**
+     * The maximum number of segments in a block.
+     */
+    static constexpr int MAX_SEGMENTS = 64;
+
+    /**
+     * A part of the block with a constant tempo.
+     */
+    class Segment {
+    public:
+
+        /**
+         * The sample offset the segment starts at. May be outside of the block.
+         */
+        int64 startOffset;
+
+        /**
+         * The position of the start of the segment, in fractional pulses.
+         */
+        double startPulse;
+
+        /**
+         * The number of samples per pulse.
+         */
+        double pulseSamples;
+    };
+
+
+
+    /**
+     * Constructs a tempo map at 44.1 kHz with the default timebase and a single segment.
+     */
+    ArpTempoMap();
+
+
+
+    /**
+     * Sets the sample rate the pulses are converted with.
+     *
+     * @param sampleRate the sample rate
+     */
+    void prepare(double sampleRate);
+
+    /**
+     * Sets the timebase the pulses are converted with.
+     *
+     * @param timebase the number of pulses per beat
+     */
+    void setTimebase(int timebase);
+
+    /**
+     * Gets the number of samples per pulse at a tempo.
+     *
+     * @param bpm the tempo in beats per minute
+     * @return the number of samples per pulse
+     */
+    double getPulseSamples(double bpm) const;
+
+
+
+    /**
+     * Starts the map of a new block with a single segment.
+     *
+     * @param originPulse the position the sample offsets are measured from, in fractional pulses
+     * @param originOffset the sample offset of originPulse, which may be outside of the block
+     * @param pulseSamples the number of samples per pulse at the start of the block
+     */
+    void begin(double originPulse, int64 originOffset, double pulseSamples);
+
+    /**
+     * Changes the tempo from a sample offset on, starting a new segment. The changes have to be added in ascending
+     * order of their offsets; changes past the last segment the map has room for are ignored.
+     *
+     * @param offset the sample offset the tempo changes at
+     * @param pulseSamples the number of samples per pulse from the offset on
+     */
+    void changeTempo(int64 offset, double pulseSamples);
+
+    /**
+     * Gets the number of segments of the block.
+     *
+     * @return the number of segments
+     */
+    int getNumSegments() const;
+
+    /**
+     * Gets the segment the block ends in.
+     *
+     * @return the last segment
+     */
+    const Segment &getLastSegment() const;
+
+
+
+    /**
+     * Gets the position at a sample offset.
+     *
+     * @param offset the sample offset
+     * @return the position in fractional pulses
+     */
+    double getPulse(int64 offset) const;
+
+    /**
+     * Gets the sample offset of a pulse.
+     *
+     * @param time the pulse
+     * @return the sample offset, which may be outside of the block
+     */
+    int64 getOffset(int64 time) const;
+
+    /**
+     * Gets the first pulse whose sample offset is at or after the specified one.
+     *
+     * @param offset the sample offset
+     * @return the first pulse at or after the offset
+     */
+    int64 getFirstPulse(int64 offset) const;
+
+private:
+
+    /**
+     * The sample rate.
+     */
+    double sampleRate;
+
+    /**
+     * The number of pulses per beat.
+     */
+    int timebase;
+
+    /**
+     * The number of samples per pulse at a tempo of one beat per minute.
+     */
+    double bpmPulseSamples;
+
+    /**
+     * The segments of the block, in ascending order.
+     */
+    Segment segments[MAX_SEGMENTS];
+
+    /**
+     * The number of segments of the block.
+     */
+    int numSegments;
+
+
+
+    /**
+     * Finds the segment a sample offset falls into.
+     *
+     * @param offset the sample offset
+     * @return the segment
+     */
+    const Segment &findByOffset(int64 offset) const;
+
+    /**
+     * Finds the segment a pulse falls into.
+     *
+     * @param time the pulse
+     * @return the segment
+     */
+    const Segment &findByPulse(int64 time) const;
+};
@@ -0,0 +1,86 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "ArpVoiceTable.h"
+
+ArpVoiceTable::ArpVoiceTable() {
+    this->numVoices = 0;
+    for (auto &channel : this->refCounts) {
+        for (auto &count : channel) {
+            count = 0;
+        }
+    }
+}
+
+
+bool ArpVoiceTable::start(
+        std::vector<ArpBuiltEvents::EventNoteData> &data,
+        uint32 dataIndex,
+        int channel,
+        int note) {
+
+    jassert(data[dataIndex].voice < 0);
+    jassert(channel >= 1 && channel <= NUM_CHANNELS);
+
+    if (this->numVoices >= MAX_VOICES || note < 0 || note >= NUM_NOTES) {
+        return false;
+    }
+
+    auto position = this->numVoices++;
+    auto &voice = this->voices[position];
+    voice.dataIndex = dataIndex;
+    voice.channel = static_cast<uint8>(channel - 1);
+    voice.note = static_cast<uint8>(note);
+    auto &slot = this->refCounts[voice.channel][voice.note];
+    slot++;
+
+    auto &voiceData = data[dataIndex];
+    voiceData.voice = position;
+    voiceData.lastNote = note;
+    return slot == 1;
+}
+
+
+int ArpVoiceTable::getNumVoices() const {
+    return this->numVoices;
+}
+
+int ArpVoiceTable::getDataIndices(uint32 *destination) const {
+    for (int i = 0; i < this->numVoices; i++) {
+        destination[i] = this->voices[i].dataIndex;
+    }
+    return this->numVoices;
+}
+
+
+bool ArpVoiceTable::remove(std::vector<ArpBuiltEvents::EventNoteData> &data, int position) {
+    auto voice = this->voices[position];
+
+    auto &voiceData = data[voice.dataIndex];
+    voiceData.voice = -1;
+    voiceData.lastNote = -1;
+
+    auto last = --this->numVoices;
+    if (position != last) {
+        this->voices[position] = this->voices[last];
+        data[this->voices[position].dataIndex].voice = position;
+    }
+
+    auto &slot = this->refCounts[voice.channel][voice.note];
+    slot--;
+    return slot == 0;
+}
@@ -0,0 +1,239 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <vector>
+#include "JuceHeader.h"
+#include "ArpBuiltEvents.h"
+
+/**
+ * A fixed-size table of the voices the arpeggiator is playing.
+ *
+ * Each voice is a pattern note data sounding a MIDI note on a channel. Several voices may sound the same MIDI note, so
+ * every channel and note slot keeps a reference count: a note on is only due when its first voice is started, and a
+ * note off once its last voice is stopped.
+ * Every voice knows its position in the table through EventNoteData::voice, so starting and stopping a voice is O(1).
+ * The table never allocates.
+ */
+class ArpVoiceTable {
+public:
+    static constexpr int NUM_CHANNELS = 16;
+    static constexpr int NUM_NOTES = 128;
+
+    /**
+     * The maximum number of voices playing at once. Further voices are not started.
+     */
+    static constexpr int MAX_VOICES = 4096;
+
+    /**
+     * Constructs an empty voice table.
+     */
+    ArpVoiceTable();
+
+
+
+    /**
+     * Starts a voice of the specified note data. The data must not have a voice already.
+     *
+     * @param data the note data of the events being played
+     * @param dataIndex the index of the note data starting the voice
+     * @param channel the MIDI channel, from 1 to 16
+     * @param note the MIDI note number
+     * @return true if the voice is the first one sounding its MIDI note, so that a note on is due; false if the MIDI
+     * note is sounding already or if the table is full
+     */
+    bool start(std::vector<ArpBuiltEvents::EventNoteData> &data, uint32 dataIndex, int channel, int note);
+
+    /**
+     * Stops the voice of the specified note data, if it has one.
+     *
+     * @param data the note data of the events being played
+     * @param dataIndex the index of the note data
+     * @param noteOff the function called as noteOff(channel, note) if the stopped voice was the last one sounding its
+     * MIDI note
+     */
+    template <typename NoteOffCallback>
+    void stop(std::vector<ArpBuiltEvents::EventNoteData> &data, uint32 dataIndex, NoteOffCallback &&noteOff);
+
+    /**
+     * Stops all the voices.
+     *
+     * @param data the note data of the events being played
+     * @param noteOff the function called as noteOff(channel, note) once for every MIDI note that was sounding
+     */
+    template <typename NoteOffCallback>
+    void stopAll(std::vector<ArpBuiltEvents::EventNoteData> &data, NoteOffCallback &&noteOff);
+
+    /**
+     * Moves the voices over to the note data of newly built events. Each voice is either kept by the note data the
+     * mapping returns for it, or stopped. A voice is also stopped if another one has already been moved to the same
+     * note data.
+     *
+     * @param oldData the note data the voices are playing
+     * @param newData the note data the voices are moved to, none of which may have a voice yet
+     * @param map the function called as map(dataIndex, channel, note) for every voice, returning the index of the note
+     * data in newData keeping the voice, or -1 to stop it
+     * @param noteOff the function called as noteOff(channel, note) once for every MIDI note that stopped sounding
+     */
+    template <typename MapCallback, typename NoteOffCallback>
+    void migrate(
+            std::vector<ArpBuiltEvents::EventNoteData> &oldData,
+            std::vector<ArpBuiltEvents::EventNoteData> &newData,
+            MapCallback &&map,
+            NoteOffCallback &&noteOff);
+
+
+
+    /**
+     * Gets the number of voices currently playing.
+     *
+     * @return the number of voices currently playing
+     */
+    int getNumVoices() const;
+
+    /**
+     * Copies the indices of the note data of all the playing voices, in no particular order.
+     *
+     * @param destination the array to copy the indices into, with room for at least MAX_VOICES entries
+     * @return the number of indices copied
+     */
+    int getDataIndices(uint32 *destination) const;
+
+private:
+
+    /**
+     * A single playing voice.
+     */
+    class Voice {
+    public:
+
+        /**
+         * The index of the note data playing the voice.
+         */
+        uint32 dataIndex;
+
+        /**
+         * The MIDI channel of the voice, from 0 to 15.
+         */
+        uint8 channel;
+
+        /**
+         * The MIDI note number of the voice.
+         */
+        uint8 note;
+    };
+
+
+
+    /**
+     * The playing voices. Only the first numVoices are valid.
+     */
+    Voice voices[MAX_VOICES];
+
+    /**
+     * The number of playing voices.
+     */
+    int numVoices;
+
+    /**
+     * The number of voices sounding each channel and note slot.
+     */
+    uint16 refCounts[NUM_CHANNELS][NUM_NOTES];
+
+
+
+    /**
+     * Removes the voice at the specified position, moving the last voice into its place.
+     *
+     * @param data the note data of the events being played
+     * @param position the position of the voice in the table
+     * @return true if the removed voice was the last one sounding its slot
+     */
+    bool remove(std::vector<ArpBuiltEvents::EventNoteData> &data, int position);
+};
+
+
+
+template <typename NoteOffCallback>
+void ArpVoiceTable::stop(
+        std::vector<ArpBuiltEvents::EventNoteData> &data,
+        uint32 dataIndex,
+        NoteOffCallback &&noteOff) {
+
+    auto position = data[dataIndex].voice;
+    if (position < 0) {
+        return;
+    }
+
+    auto voice = this->voices[position];
+    if (remove(data, position)) {
+        noteOff(voice.channel + 1, static_cast<int>(voice.note));
+    }
+}
+
+template <typename NoteOffCallback>
+void ArpVoiceTable::stopAll(std::vector<ArpBuiltEvents::EventNoteData> &data, NoteOffCallback &&noteOff) {
+    for (int i = 0; i < this->numVoices; i++) {
+        auto &voice = this->voices[i];
+        auto &slot = this->refCounts[voice.channel][voice.note];
+        if (slot > 0) {
+            slot = 0;
+            noteOff(voice.channel + 1, static_cast<int>(voice.note));
+        }
+
+        auto &voiceData = data[voice.dataIndex];
+        voiceData.voice = -1;
+        voiceData.lastNote = -1;
+    }
+    this->numVoices = 0;
+}
+
+template <typename MapCallback, typename NoteOffCallback>
+void ArpVoiceTable::migrate(
+        std::vector<ArpBuiltEvents::EventNoteData> &oldData,
+        std::vector<ArpBuiltEvents::EventNoteData> &newData,
+        MapCallback &&map,
+        NoteOffCallback &&noteOff) {
+
+    // The kept voices are compacted towards the start of the table, in their original order
+    int numKept = 0;
+    for (int i = 0; i < this->numVoices; i++) {
+        auto voice = this->voices[i];
+        auto &voiceData = oldData[voice.dataIndex];
+        voiceData.voice = -1;
+        voiceData.lastNote = -1;
+
+        auto newIndex = map(voice.dataIndex, voice.channel + 1, static_cast<int>(voice.note));
+        if (newIndex < 0 || newData[static_cast<size_t>(newIndex)].voice >= 0) {
+            auto &slot = this->refCounts[voice.channel][voice.note];
+            if (--slot == 0) {
+                noteOff(voice.channel + 1, static_cast<int>(voice.note));
+            }
+            continue;
+        }
+
+        auto position = numKept++;
+        voice.dataIndex = static_cast<uint32>(newIndex);
+        this->voices[position] = voice;
+
+        auto &newVoiceData = newData[voice.dataIndex];
+        newVoiceData.voice = position;
+        newVoiceData.lastNote = voice.note;
+    }
+    this->numVoices = numKept;
+}
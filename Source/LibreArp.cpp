@@ -16,16 +16,19 @@
 //
 
 #include "LibreArp.h"
+#include "ArpPatternParser.h"
 #include "editor/MainEditor.h"
 #include "exception/ArpIntegrityException.h"
+#include "debug/AllocationTracker.h"
 
 const Identifier LibreArp::TREEID_LIBREARP = Identifier("libreArpPlugin"); // NOLINT
-const Identifier LibreArp::TREEID_LOOP_RESET = Identifier("loopReset"); // NOLINT
 const Identifier LibreArp::TREEID_PATTERN_XML = Identifier("patternXml"); // NOLINT
-const Identifier LibreArp::TREEID_OCTAVES = Identifier("octaves"); // NOLINT
-const Identifier LibreArp::TREEID_NUM_INPUT_NOTES = Identifier("numInputNotes"); // NOLINT
-const Identifier LibreArp::TREEID_OUTPUT_MIDI_CHANNEL = Identifier("outputMidiChannel"); // NOLINT
-const Identifier LibreArp::TREEID_INPUT_MIDI_CHANNEL = Identifier("inputMidiChannel"); // NOLINT
+
+const int STATE_MAGIC = 0x4272414c; // "LArB" in little endian, which legacy XML state cannot start with
+const int STATE_FORMAT_VERSION = 1;
+const int STATE_HEADER_SIZE = 16; // Magic, version, flags and payload size
+const int STATE_FLAG_COMPRESSED = 1;
+const size_t STATE_COMPRESSION_THRESHOLD = 4096;
 
 //==============================================================================
 LibreArp::LibreArp()
@@ -40,20 +43,18 @@ LibreArp::LibreArp()
 )
 #endif
 {
-    this->lastPosition = 0;
-    this->wasPlaying = false;
-    this->buildScheduled = false;
-    this->stopScheduled = false;
-    this->loopReset = 0.0;
-    this->numInputNotes = 0;
-    this->outputMidiChannel = 1;
-    this->inputMidiChannel = 0;
-
     addParameter(octaves = new AudioParameterBool(
             "octaves",
             "Octaves",
             true,
             "Overflow octave transport"));
+
+    this->patternVersion = 0;
+    this->patternXmlVersion = 0;
+    this->stateDirty = true;
+    this->savedOctaves = false;
+    this->savedNumInputNotes = 0;
+    snapshotPattern();
 }
 
 LibreArp::~LibreArp() = default;
@@ -114,12 +115,13 @@ void LibreArp::changeProgramName(int index, const String &newName) {
 
 //==============================================================================
 void LibreArp::prepareToPlay(double sampleRate, int samplesPerBlock) {
-    ignoreUnused(samplesPerBlock);
-    ignoreUnused(sampleRate);
+    engine.prepare(sampleRate, samplesPerBlock);
 }
 
 void LibreArp::releaseResources() {
-
+#if LIBREARP_TRACK_ALLOCATIONS
+    AllocationTracker::report();
+#endif
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -148,6 +150,7 @@ bool LibreArp::isBusesLayoutSupported(const BusesLayout &layouts) const {
 #endif
 
 void LibreArp::processBlock(AudioBuffer<float> &audio, MidiBuffer &midi) {
+    LIBREARP_AUDIO_THREAD_SCOPE("processBlock");
     ScopedNoDenormals noDenormals;
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
@@ -158,109 +161,18 @@ void LibreArp::processBlock(AudioBuffer<float> &audio, MidiBuffer &midi) {
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         audio.clear(i, 0, numSamples);
 
-    // Build events if scheduled
-    if (buildScheduled) {
-        this->stopAll();
-        events = pattern.buildEvents();
-        buildScheduled = false;
-    }
-
-    processInputMidi(midi);
-
     AudioPlayHead::CurrentPositionInfo cpi; // NOLINT
     getPlayHead()->getCurrentPosition(cpi);
 
-    this->timeSigNumerator = cpi.timeSigNumerator;
-    this->timeSigDenominator = cpi.timeSigDenominator;
-
-    if (cpi.isPlaying && !this->events.events.empty()) {
-        auto timebase = this->events.timebase;
-        auto pulseLength = 60.0 / (cpi.bpm * timebase);
-        auto pulseSamples = getSampleRate() * pulseLength;
-
-        auto lastPosition = static_cast<int64>(std::floor(cpi.ppqPosition * timebase));
-        auto position = lastPosition + static_cast<int64>(std::ceil(numSamples / pulseSamples));
-
-        if (stopScheduled) {
-            this->stopAll(midi);
-            stopScheduled = false;
-        }
+    ArpEngine::Transport transport;
+    transport.isPlaying = cpi.isPlaying;
+    transport.bpm = cpi.bpm;
+    transport.ppqPosition = cpi.ppqPosition;
+    transport.timeSigNumerator = cpi.timeSigNumerator;
+    transport.timeSigDenominator = cpi.timeSigDenominator;
 
-        if (inputNotes.size() != 0) {
-            numInputNotes = inputNotes.size();
-        }
-
-        for(auto event : events.events) {
-            auto time = nextTime(event, position, lastPosition);
-
-            if (time < position) {
-                auto offsetBase = static_cast<int>(std::floor((time - this->lastPosition) * pulseSamples));
-                int offset = jmin(offsetBase, numSamples - 1);
-
-                if (this->lastPosition > position && offset < 0) {
-                    offset = 0;
-                }
-
-                if (offset >= 0) {
-                    for (auto i : event.offs) {
-                        auto &data = events.data[i];
-                        if (data.lastNote >= 0) {
-                            midi.addEvent(MidiMessage::noteOff(outputMidiChannel, data.lastNote), offset);
-                            playingNotes.removeValue(data.lastNote);
-                            playingPatternIndices.removeValue(data.noteIndex);
-                            data.lastNote = -1;
-                        }
-                    }
-
-                    if (!inputNotes.isEmpty()) {
-                        for (auto i : event.ons) {
-                            auto &data = events.data[i];
-                            auto index = data.noteNumber % inputNotes.size();
-                            if (index < 0) {
-                                index += inputNotes.size();
-                            }
-
-                            auto note = inputNotes[index];
-                            if (octaves->get()) {
-                                auto octave = data.noteNumber / inputNotes.size();
-                                if (data.noteNumber < 0) {
-                                    octave--;
-                                }
-                                note += octave * 12;
-                            }
-
-                            if (data.lastNote != note) {
-                                data.lastNote = note;
-                                midi.addEvent(
-                                        MidiMessage::noteOn(
-                                                outputMidiChannel, note, static_cast<float>(data.velocity)), offset);
-                                playingNotes.add(note);
-                                playingPatternIndices.add(data.noteIndex);
-                            }
-                        }
-                    }
-                }
-            }
-        }
-
-        if (getActiveEditor() != nullptr && getActiveEditor()->isVisible()) {
-            getActiveEditor()->repaint();
-        }
-
-        this->lastPosition = position;
-        this->wasPlaying = true;
-    } else {
-        if (this->wasPlaying) {
-            if (getActiveEditor() != nullptr && getActiveEditor()->isVisible()) {
-                getActiveEditor()->repaint();
-            }
-
-            this->stopAll(midi);
-        }
-
-        this->lastPosition = 0;
-        this->wasPlaying = false;
-    }
+    engine.setOctaves(octaves->get());
+    engine.process(transport, numSamples, midi, isNonRealtime());
 }
 
 //==============================================================================
@@ -274,220 +186,259 @@ AudioProcessorEditor *LibreArp::createEditor() {
 
 //==============================================================================
 void LibreArp::getStateInformation(MemoryBlock &destData) {
-    ValueTree tree = ValueTree(TREEID_LIBREARP);
-    tree.appendChild(this->pattern.toValueTree(), nullptr);
-    tree.appendChild(this->editorState.toValueTree(), nullptr);
-    tree.setProperty(TREEID_LOOP_RESET, this->loopReset, nullptr);
-    tree.setProperty(TREEID_PATTERN_XML, this->patternXml, nullptr);
-    tree.setProperty(TREEID_OCTAVES, this->octaves->get(), nullptr);
-    tree.setProperty(TREEID_NUM_INPUT_NOTES, this->numInputNotes, nullptr);
-    tree.setProperty(TREEID_OUTPUT_MIDI_CHANNEL, this->outputMidiChannel, nullptr);
-    tree.setProperty(TREEID_INPUT_MIDI_CHANNEL, this->inputMidiChannel, nullptr);
+    // Hosts save every few seconds, so the state is only written again when something in it has changed
+    auto octavesValue = this->octaves->get();
+    auto numInputNotes = this->engine.getNumInputNotes();
+    if (this->stateDirty.exchange(false)
+            || octavesValue != this->savedOctaves
+            || numInputNotes != this->savedNumInputNotes
+            || this->editorState != this->savedEditorState) {
+
+        writeBinaryState(this->savedState);
+        this->savedEditorState = this->editorState;
+        this->savedOctaves = octavesValue;
+        this->savedNumInputNotes = numInputNotes;
+    }
 
-    destData.reset();
-    MemoryOutputStream(destData, true).writeString(tree.toXmlString());
+    destData = this->savedState;
 }
 
 void LibreArp::setStateInformation(const void *data, int sizeInBytes) {
     if (sizeInBytes > 0) {
-        String xml = MemoryInputStream(data, static_cast<size_t>(sizeInBytes), false).readString();
-        XmlElement *doc = XmlDocument::parse(xml);
-        ValueTree tree = ValueTree::fromXml(*doc);
-        delete doc;
-
-        if (tree.isValid() && tree.hasType(TREEID_LIBREARP)) {
-            ValueTree patternTree = tree.getChildWithName(ArpPattern::TREEID_PATTERN);
-            ArpPattern pattern = ArpPattern::fromValueTree(patternTree);
-
-            ValueTree editorTree = tree.getChildWithName(EditorState::TREEID_EDITOR_STATE);
-            if (editorTree.isValid()) {
-                this->editorState = EditorState::fromValueTree(editorTree);
-            }
-
-            if (tree.hasProperty(TREEID_LOOP_RESET)) {
-                this->loopReset = tree.getProperty(TREEID_LOOP_RESET);
-            }
-
-            if (tree.hasProperty(TREEID_OCTAVES)) {
-                *this->octaves = tree.getProperty(TREEID_OCTAVES);
-            }
-
-            if (tree.hasProperty(TREEID_NUM_INPUT_NOTES)) {
-                this->numInputNotes = tree.getProperty(TREEID_NUM_INPUT_NOTES);
-            }
-
-            if (tree.hasProperty(TREEID_OUTPUT_MIDI_CHANNEL)) {
-                this->outputMidiChannel = tree.getProperty(TREEID_OUTPUT_MIDI_CHANNEL);
-            }
-
-            if (tree.hasProperty(TREEID_INPUT_MIDI_CHANNEL)) {
-                this->inputMidiChannel = tree.getProperty(TREEID_INPUT_MIDI_CHANNEL);
-            }
-
-            if (tree.hasProperty(TREEID_PATTERN_XML)) {
-                this->patternXml = tree.getProperty(TREEID_PATTERN_XML);
-                setPattern(pattern, false);
+        MemoryInputStream stream(data, static_cast<size_t>(sizeInBytes), false);
+        try {
+            if (sizeInBytes >= STATE_HEADER_SIZE && stream.readInt() == STATE_MAGIC) {
+                readBinaryState(stream);
             } else {
-                setPattern(pattern, true);
+                stream.setPosition(0);
+                readXmlState(stream.readString());
             }
+        } catch (ArpIntegrityException &e) {
+            // Corrupt state is ignored, leaving the current one in place
+            Logger::writeToLog(String("LibreArp: could not load the saved state: ") + e.what());
         }
     }
 }
 
-void LibreArp::setPattern(ArpPattern &pattern, bool updateXml) {
+void LibreArp::setPattern(ArpPattern &pattern) {
     this->pattern = pattern;
-    if (updateXml) {
-        this->patternXml = pattern.toValueTree().toXmlString();
-    }
     buildPattern();
 }
 
 void LibreArp::parsePattern(const String &xmlPattern) {
-    XmlElement *doc = XmlDocument::parse(xmlPattern);
-    if (doc == nullptr) {
-        throw ArpIntegrityException("Malformed XML!");
-    }
-    ValueTree tree = ValueTree::fromXml(*doc);
-    delete doc;
-    ArpPattern pattern = ArpPattern::fromValueTree(tree);
-    setPattern(pattern, false);
+    ArpPattern pattern = ArpPatternParser(xmlPattern).parse();
+    setPattern(pattern);
     this->patternXml = xmlPattern;
+    this->patternXmlVersion = this->patternVersion;
 }
 
 void LibreArp::buildPattern() {
-    this->buildScheduled = true;
+    engine.compile(snapshotPattern());
+}
+
+void LibreArp::buildPattern(const std::vector<uint64> &changedNotes) {
+    engine.compile(snapshotPattern(), changedNotes);
+}
+
+void LibreArp::reclaimEvents() {
+    engine.reclaimEvents();
 }
 
 ArpPattern &LibreArp::getPattern() {
     return this->pattern;
 }
 
-String &LibreArp::getPatternXml() {
-    return this->patternXml;
+std::shared_ptr<const ArpPattern> LibreArp::getPatternSnapshot() {
+    return std::atomic_load(&this->patternSnapshot);
 }
 
+uint64 LibreArp::getPatternVersion() {
+    return this->patternVersion;
+}
 
-int64 LibreArp::getLastPosition() {
-    return this->lastPosition;
+const String &LibreArp::getPatternXml() {
+    if (this->patternXmlVersion != this->patternVersion) {
+        this->patternXml = this->pattern.toValueTree().toXmlString();
+        this->patternXmlVersion = this->patternVersion;
+    }
+    return this->patternXml;
 }
 
 
 
 void LibreArp::setLoopReset(double loopReset) {
-    this->loopReset = jmax(0.0, loopReset);
+    this->engine.setLoopReset(loopReset);
+    this->stateDirty = true;
 }
 
 double LibreArp::getLoopReset() {
-    return this->loopReset;
+    return this->engine.getLoopReset();
 }
 
 
 
-SortedSet<unsigned long>& LibreArp::getPlayingPatternIndices() {
-    return this->playingPatternIndices;
+const ArpPlaybackState::Snapshot &LibreArp::getPlaybackSnapshot() {
+    return this->engine.getPlaybackSnapshot();
 }
 
 
 
-int LibreArp::getNumInputNotes() {
-    return this->numInputNotes;
+int LibreArp::getOutputMidiChannel() {
+    return this->engine.getOutputMidiChannel();
 }
 
-int LibreArp::getTimeSigNumerator() {
-    return this->timeSigNumerator;
+void LibreArp::setOutputMidiChannel(int channel) {
+    this->engine.setOutputMidiChannel(channel);
+    this->stateDirty = true;
 }
 
-int LibreArp::getTimeSigDenominator() {
-    return this->timeSigDenominator;
+
+
+int LibreArp::getInputMidiChannel() {
+    return this->engine.getInputMidiChannel();
 }
 
+void LibreArp::setInputMidiChannel(int channel) {
+    this->engine.setInputMidiChannel(channel);
+    this->stateDirty = true;
+}
 
 
-int LibreArp::getOutputMidiChannel() {
-    return this->outputMidiChannel;
+
+int LibreArp::getTranspose() {
+    return this->engine.getTranspose();
 }
 
-void LibreArp::setOutputMidiChannel(int channel) {
-    jassert(channel >= 1 && channel <= 16);
-    this->outputMidiChannel = channel;
+void LibreArp::setTranspose(int semitones) {
+    this->engine.setTranspose(semitones);
+    this->stateDirty = true;
 }
 
+bool LibreArp::getVelocityScaling() {
+    return this->engine.getVelocityScaling();
+}
 
+void LibreArp::setVelocityScaling(bool velocityScaling) {
+    this->engine.setVelocityScaling(velocityScaling);
+    this->stateDirty = true;
+}
 
-int LibreArp::getInputMidiChannel() {
-    return this->inputMidiChannel;
+bool LibreArp::getDeterministic() {
+    return this->engine.getDeterministic();
 }
 
-void LibreArp::setInputMidiChannel(int channel) {
-    jassert(channel >= 0 && channel <= 16);
-    this->inputMidiChannel = channel;
+void LibreArp::setDeterministic(bool deterministic) {
+    this->engine.setDeterministic(deterministic);
+    this->stateDirty = true;
 }
 
 
 
-void LibreArp::processInputMidi(MidiBuffer &inMidi) {
-    int sample;
-    MidiBuffer outMidi;
-    MidiMessage message;
+void LibreArp::stopAll() {
+    this->engine.stopAll();
+}
 
-    for (MidiBuffer::Iterator i(inMidi); i.getNextEvent(message, sample);) {
-        if (inputMidiChannel == 0 || message.getChannel() == inputMidiChannel) {
-            if (message.isNoteOn()) {
-                inputNotes.add(message.getNoteNumber());
-            } else if (message.isNoteOff()) {
-                inputNotes.removeValue(message.getNoteNumber());
-            } else {
-                outMidi.addEvent(message, sample);
-            }
-        } else {
-            outMidi.addEvent(message, sample);
-        }
-    }
 
-    inMidi.swapWith(outMidi);
-}
 
+void LibreArp::writeBinaryState(MemoryBlock &destData) {
+    // The settings stay a value tree, the pattern is written as fixed-width records after it
+    ValueTree settings = ValueTree(TREEID_LIBREARP);
+    settings.appendChild(this->editorState.toValueTree(), nullptr);
+    this->engine.writeState(settings);
 
+    // The engine only picks the parameter up on the audio thread, so the parameter itself is saved
+    settings.setProperty(ArpEngine::TREEID_OCTAVES, this->octaves->get(), nullptr);
 
-void LibreArp::stopAll() {
-    this->stopScheduled = true;
+    MemoryOutputStream payload;
+    settings.writeToStream(payload);
+    this->pattern.writeBinary(payload);
+
+    auto isCompressed = payload.getDataSize() >= STATE_COMPRESSION_THRESHOLD;
+
+    destData.reset();
+    MemoryOutputStream stream(destData, false);
+    stream.writeInt(STATE_MAGIC);
+    stream.writeInt(STATE_FORMAT_VERSION);
+    stream.writeInt(isCompressed ? STATE_FLAG_COMPRESSED : 0);
+    stream.writeInt(static_cast<int>(payload.getDataSize()));
+    if (isCompressed) {
+        GZIPCompressorOutputStream compressor(stream);
+        compressor.write(payload.getData(), payload.getDataSize());
+    } else {
+        stream.write(payload.getData(), payload.getDataSize());
+    }
 }
 
-void LibreArp::stopAll(MidiBuffer &midi) {
-    for (auto noteNumber : playingNotes) {
-        midi.addEvent(MidiMessage::noteOff(outputMidiChannel, noteNumber), 0);
+void LibreArp::readBinaryState(InputStream &stream) {
+    auto version = stream.readInt();
+    if (version < 1 || version > STATE_FORMAT_VERSION) {
+        throw ArpIntegrityException("Unsupported state format version!");
     }
-    playingNotes.clear();
-    playingPatternIndices.clear();
 
-    for (auto &data : events.data) {
-        data.lastNote = -1;
+    auto flags = stream.readInt();
+    auto payloadSize = stream.readInt();
+    if (payloadSize < 0) {
+        throw ArpIntegrityException("Malformed state!");
+    }
+
+    MemoryBlock payload;
+    if (flags & STATE_FLAG_COMPRESSED) {
+        GZIPDecompressorInputStream decompressor(stream);
+        decompressor.readIntoMemoryBlock(payload, payloadSize);
+    } else {
+        stream.readIntoMemoryBlock(payload, payloadSize);
+    }
+    if (payload.getSize() != static_cast<size_t>(payloadSize)) {
+        throw ArpIntegrityException("Truncated state!");
     }
-}
 
+    MemoryInputStream payloadStream(payload, false);
+    ValueTree settings = ValueTree::readFromStream(payloadStream);
+    if (!settings.isValid() || !settings.hasType(TREEID_LIBREARP)) {
+        throw ArpIntegrityException("Malformed state!");
+    }
+    ArpPattern pattern = ArpPattern::readBinary(payloadStream);
 
+    readSettings(settings);
+    setPattern(pattern);
+}
 
-int64 LibreArp::nextTime(ArpBuiltEvents::Event &event, int64 position, int64 lastPosition) {
-    int64 result;
+void LibreArp::readXmlState(const String &xml) {
+    ValueTree settings = ValueTree(TREEID_LIBREARP);
+    ArpPattern pattern = ArpPatternParser(xml).parseState(TREEID_LIBREARP, settings);
 
-    if (loopReset > 0.0) {
-        auto loopResetLength = static_cast<int64>(std::ceil(events.timebase * loopReset));
-        auto resetPosition = position % loopResetLength;
-        auto intermediateResult = resetPosition - (resetPosition % events.loopLength) + event.time;
-        intermediateResult %= loopResetLength;
+    readSettings(settings);
+    setPattern(pattern);
 
-        result = position - (position % loopResetLength) + intermediateResult;
-    } else {
-        result = position - (position % events.loopLength) + event.time;
+    if (settings.hasProperty(TREEID_PATTERN_XML)) {
+        this->patternXml = settings.getProperty(TREEID_PATTERN_XML);
+        this->patternXmlVersion = this->patternVersion;
     }
+}
 
-    if (result < lastPosition) {
-        result += events.loopLength;
+void LibreArp::readSettings(ValueTree &tree) {
+    ValueTree editorTree = tree.getChildWithName(EditorState::TREEID_EDITOR_STATE);
+    if (editorTree.isValid()) {
+        this->editorState = EditorState::fromValueTree(editorTree);
     }
 
-    return result;
+    this->engine.readState(tree);
+    if (tree.hasProperty(ArpEngine::TREEID_OCTAVES)) {
+        *this->octaves = tree.getProperty(ArpEngine::TREEID_OCTAVES);
+    }
+    this->stateDirty = true;
+}
+
+std::shared_ptr<const ArpPattern> LibreArp::snapshotPattern() {
+    auto snapshot = std::make_shared<const ArpPattern>(this->pattern);
+    std::atomic_store(&this->patternSnapshot, snapshot);
+    this->patternVersion++;
+    this->stateDirty = true;
+    return snapshot;
 }
 
+
+
 //==============================================================================
 // This creates new instances of the plugin..
 AudioProcessor *JUCE_CALLTYPE createPluginFilter() {
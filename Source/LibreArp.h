@@ -17,9 +17,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <sstream>
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "ArpPattern.h"
+#include "ArpEngine.h"
 #include "editor/EditorState.h"
 
 /**
@@ -28,12 +31,7 @@
 class LibreArp : public AudioProcessor {
 public:
     static const Identifier TREEID_LIBREARP;
-    static const Identifier TREEID_LOOP_RESET;
     static const Identifier TREEID_PATTERN_XML;
-    static const Identifier TREEID_OCTAVES;
-    static const Identifier TREEID_NUM_INPUT_NOTES;
-    static const Identifier TREEID_OUTPUT_MIDI_CHANNEL;
-    static const Identifier TREEID_INPUT_MIDI_CHANNEL;
 
 
     LibreArp();
@@ -98,88 +96,91 @@ public:
      * Sets the pattern to play.
      *
      * @param pattern the pattern to play
-     * @param updateXml whether the XML representation should be updated
      */
-    void setPattern(ArpPattern &pattern, bool updateXml = true);
+    void setPattern(ArpPattern &pattern);
 
     /**
      * Parses the pattern to play from the given XML data.
      *
      * @param xmlPattern the XML data
+     * @throws ArpIntegrityException if the XML is malformed or does not represent a pattern
      */
     void parsePattern(const String &xmlPattern);
 
     /**
-     * Builds the current pattern.
+     * Schedules a build of the current pattern on the background compiler. The pattern is copied, so this must be
+     * called from the thread that edits it.
      */
     void buildPattern();
 
     /**
-     * Gets the current pattern.
+     * Schedules a build of the current pattern in which only the specified notes have changed since the last build,
+     * so that the built events can be updated in place. Must be called from the thread that edits the pattern.
      *
-     * @return the current pattern
+     * @param changedNotes the indices of the notes that have changed
      */
-    ArpPattern &getPattern();
+    void buildPattern(const std::vector<uint64> &changedNotes);
 
     /**
-     * Gets the current pattern's XML.
-     *
-     * @return the current pattern's XML
+     * Has the background compiler delete the built events playback has stopped using, if there are any. Meant to be
+     * polled from the message thread, e.g. by the editor.
      */
-    String &getPatternXml();
-
-
+    void reclaimEvents();
 
     /**
-     * Gets the last position the processor has played, in pulses.
+     * Gets the current pattern for editing. The edits take effect on the next build; readers should use the snapshot.
      *
-     * @return the last position the processor has played
+     * @return the current pattern
      */
-    int64 getLastPosition();
+    ArpPattern &getPattern();
 
     /**
-     * Sets the amount of beats after which the loop should reset.
+     * Gets an immutable snapshot of the current pattern as of its last build. Readers that only look at the pattern
+     * share the snapshot instead of copying the pattern, and see a consistent pattern however it is edited after.
      *
-     * @param loopReset the amount of beats after which the loop should reset
+     * @return the most recent snapshot of the current pattern
      */
-    void setLoopReset(double loopReset);
+    std::shared_ptr<const ArpPattern> getPatternSnapshot();
 
     /**
-     * Gets the amount of beats after which the loop should reset.
+     * Gets the version of the current pattern, incremented every time a new snapshot is taken. Readers may compare
+     * it against the version they last saw to skip recomputing what only depends on the pattern.
      *
-     * @return the amount of beats after which the loop should reset
+     * @return the version of the current pattern
      */
-    double getLoopReset();
+    uint64 getPatternVersion();
 
     /**
-     * Gets the currently playing pattern indices.
+     * Gets the current pattern's XML. The XML is only generated when the pattern has changed since it was last
+     * requested or parsed.
      *
-     * @return the currently playing pattern indices
+     * @return the current pattern's XML
      */
-    SortedSet<unsigned long> &getPlayingPatternIndices();
+    const String &getPatternXml();
 
 
 
     /**
-     * Gets the last active number of input notes.
+     * Sets the amount of beats after which the loop should reset.
      *
-     * @return the last active number of input notes
+     * @param loopReset the amount of beats after which the loop should reset
      */
-    int getNumInputNotes();
+    void setLoopReset(double loopReset);
 
     /**
-     * Gets the time signature numerator.
+     * Gets the amount of beats after which the loop should reset.
      *
-     * @return the time signature numerator
+     * @return the amount of beats after which the loop should reset
      */
-    int getTimeSigNumerator();
+    double getLoopReset();
 
     /**
-     * Gets the time signature denominator.
+     * Gets the most recent snapshot of the playback state. To be called from the message thread only; the snapshot
+     * stays valid until the next call.
      *
-     * @return the time signature denominator
+     * @return the most recent snapshot of the playback state
      */
-    int getTimeSigDenominator();
+    const ArpPlaybackState::Snapshot &getPlaybackSnapshot();
 
 
 
@@ -216,136 +217,163 @@ public:
 
 
 
-private:
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LibreArp);
-
     /**
-     * The persistent state of the editor.
+     * Gets the number of semitones the input notes are transposed by.
+     *
+     * @return the number of semitones the input notes are transposed by
      */
-    EditorState editorState;
+    int getTranspose();
 
+    /**
+     * Sets the number of semitones the input notes are transposed by.
+     *
+     * @param semitones the number of semitones the input notes are transposed by, negative to transpose down
+     */
+    void setTranspose(int semitones);
 
+    /**
+     * Gets whether the velocity of the pattern notes is scaled by the velocity the input notes are played with.
+     *
+     * @return whether the velocity of the pattern notes is scaled by the played velocity
+     */
+    bool getVelocityScaling();
 
     /**
-     * The current pattern.
+     * Sets whether the velocity of the pattern notes is scaled by the velocity the input notes are played with.
+     *
+     * @param velocityScaling whether the velocity of the pattern notes is scaled by the played velocity
      */
-    ArpPattern pattern;
+    void setVelocityScaling(bool velocityScaling);
 
     /**
-     * The current pattern's XML representation.
+     * Gets whether the output is independent of how the host splits the playback into blocks.
+     *
+     * @return whether the output is independent of the block sizes
      */
-    String patternXml;
+    bool getDeterministic();
 
     /**
-     * The current pattern, built for playback.
+     * Sets whether the output is independent of how the host splits the playback into blocks.
+     *
+     * @param deterministic whether the output is independent of the block sizes
      */
-    ArpBuiltEvents events;
+    void setDeterministic(bool deterministic);
 
 
 
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LibreArp);
+
     /**
-     * Whether the plugin should transpose octaves upon "note overflow".
+     * The persistent state of the editor.
      */
-    AudioParameterBool *octaves;
+    EditorState editorState;
 
 
 
     /**
-     * The last position the processor has played, in pulses.
+     * The current pattern.
      */
-    int64 lastPosition;
+    ArpPattern pattern;
 
     /**
-     * The amount of beats after which the loop should reset.
+     * The XML representation of the pattern, as of the pattern version in patternXmlVersion.
      */
-    double loopReset;
+    String patternXml;
 
     /**
-     * Whether the playhead was playing in the last block.
+     * The pattern version patternXml represents. The XML is out of date when this differs from patternVersion.
      */
-    bool wasPlaying;
-
+    uint64 patternXmlVersion;
 
+    /**
+     * The snapshot of the current pattern as of its last build, replaced as a whole on every build.
+     */
+    std::shared_ptr<const ArpPattern> patternSnapshot;
 
     /**
-     * Whether stopAll was called.
+     * The version of the pattern snapshot.
      */
-    bool stopScheduled;
+    std::atomic<uint64> patternVersion;
 
     /**
-     * Whether buildPattern was called.
+     * The playback engine.
      */
-    bool buildScheduled;
+    ArpEngine engine;
 
 
 
     /**
-     * The set of currently fed input notes.
+     * The state last written by getStateInformation, handed out again for as long as nothing in it changes.
      */
-    SortedSet<int> inputNotes;
+    MemoryBlock savedState;
 
     /**
-     * The set of currently playing output notes.
+     * Set whenever the pattern or a setting written into the state changes, cleared when the state is saved.
      */
-    SortedSet<int> playingNotes;
+    std::atomic<bool> stateDirty;
 
     /**
-     * The set of currently playing pattern indices.
+     * The editor state as of the saved state. The editor changes it directly, so it is compared instead of flagged.
      */
-    SortedSet<unsigned long> playingPatternIndices;
+    EditorState savedEditorState;
 
     /**
-     * The last active number of input notes.
+     * The octaves parameter as of the saved state. The host changes it directly, so it is compared instead of
+     * flagged.
      */
-    int numInputNotes;
+    bool savedOctaves;
 
     /**
-     * Time signature numerator.
+     * The number of input notes as of the saved state. The engine changes it as notes are played, so it is compared
+     * instead of flagged.
      */
-    int timeSigNumerator;
+    int savedNumInputNotes;
+
+
 
     /**
-     * Time signature denominator.
+     * Whether the plugin should transpose octaves upon "note overflow".
      */
-    int timeSigDenominator;
+    AudioParameterBool *octaves;
 
 
 
     /**
-     * The MIDI channel output notes are sent to.
+     * Replaces the pattern snapshot with a copy of the current pattern and increments the pattern version. Must be
+     * called from the thread that edits the pattern.
+     *
+     * @return the new snapshot
      */
-    int outputMidiChannel;
+    std::shared_ptr<const ArpPattern> snapshotPattern();
 
     /**
-     * The MIDI channel input notes are read from. Notes from all channels are read if zero.
+     * Writes the state in the binary format.
+     *
+     * @param destData the block to write the state into
      */
-    int inputMidiChannel;
-
-
+    void writeBinaryState(MemoryBlock &destData);
 
     /**
-     * Processes input MIDI messages.
+     * Reads state in the binary format, after its magic number. Nothing is changed unless all of it can be read.
      *
-     * @param inMidi the input MIDI messages
+     * @param stream the stream to read the state from
+     * @throws ArpIntegrityException if the state is truncated, corrupt or of a newer format version
      */
-    void processInputMidi(MidiBuffer &inMidi);
+    void readBinaryState(InputStream &stream);
 
     /**
-     * Sends a noteOff for all currently playing output notes.
+     * Reads state in the legacy XML format. Nothing is changed unless all of it can be read.
      *
-     * @param midi the midi messages
+     * @param xml the XML state
+     * @throws ArpIntegrityException if the XML is malformed or does not hold a pattern
      */
-    void stopAll(MidiBuffer &midi);
-
-
+    void readXmlState(const String &xml);
 
     /**
-     * Calculates the next time of the specified event.
+     * Applies the editor and engine settings stored in a state tree.
      *
-     * @param event the event of which the next time should be calculated
-     * @param position the current processed position
-     * @param lastPosition the last processed position
-     * @return the next time of the event
+     * @param tree the state tree
      */
-    int64 nextTime(ArpBuiltEvents::Event &event, int64 position, int64 lastPosition);
+    void readSettings(ValueTree &tree);
 };
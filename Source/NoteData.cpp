@@ -56,3 +56,19 @@ NoteData NoteData::fromValueTree(ValueTree &tree) {
 
     return noteData;
 }
+
+
+void NoteData::writeBinary(OutputStream &stream) const {
+    stream.writeInt(this->noteNumber);
+    stream.writeDouble(this->velocity);
+    stream.writeDouble(this->pan);
+}
+
+
+NoteData NoteData::readBinary(InputStream &stream) {
+    NoteData noteData = NoteData();
+    noteData.noteNumber = stream.readInt();
+    noteData.velocity = stream.readDouble();
+    noteData.pan = stream.readDouble();
+    return noteData;
+}
@@ -17,7 +17,7 @@
 
 #pragma once
 
-#include "../JuceLibraryCode/JuceHeader.h"
+#include "JuceHeader.h"
 
 /**
  * The data of a note.
@@ -29,6 +29,11 @@ public:
     static const Identifier TREEID_VELOCITY;
     static const Identifier TREEID_PAN;
 
+    /**
+     * The size of note data written by writeBinary, in bytes.
+     */
+    static const int BINARY_SIZE = 20;
+
     /**
      * The index of the note among the input notes.
      */
@@ -67,6 +72,21 @@ public:
      * @return the note represented by the ValueTree
      */
     static NoteData fromValueTree(ValueTree &tree);
+
+    /**
+     * Writes this data into a stream as a fixed-width record of BINARY_SIZE bytes.
+     *
+     * @param stream the stream to write into
+     */
+    void writeBinary(OutputStream &stream) const;
+
+    /**
+     * Reads note data written by writeBinary from a stream.
+     *
+     * @param stream the stream to read from
+     * @return the note data read
+     */
+    static NoteData readBinary(InputStream &stream);
 };
 
 
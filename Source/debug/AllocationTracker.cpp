@@ -0,0 +1,222 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "AllocationTracker.h"
+
+#if LIBREARP_TRACK_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(__GLIBC__)
+#define LIBREARP_TRACK_MALLOC 1
+
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void __libc_free(void *ptr);
+}
+#else
+#define LIBREARP_TRACK_MALLOC 0
+#endif
+
+namespace {
+
+    /**
+     * Allocation counts of a single tag.
+     */
+    struct TagCount {
+        std::atomic<const char *> tag;
+        std::atomic<int> count;
+        std::atomic<size_t> bytes;
+    };
+
+    TagCount tagCounts[AllocationTracker::MAX_TAGS];
+
+    std::atomic<int> numAllocations(0);
+
+    /**
+     * The tag of the innermost audio thread scope of the current thread, null if the thread is not in any.
+     * The initial-exec model keeps the first access of the variable from allocating in dynamically loaded binaries.
+     */
+#if defined(__GNUC__)
+    __attribute__((tls_model("initial-exec")))
+#endif
+    thread_local const char *currentTag = nullptr;
+
+
+    void *rawMalloc(size_t size) {
+#if LIBREARP_TRACK_MALLOC
+        return __libc_malloc(size);
+#else
+        return std::malloc(size);
+#endif
+    }
+
+    void rawFree(void *ptr) {
+#if LIBREARP_TRACK_MALLOC
+        __libc_free(ptr);
+#else
+        std::free(ptr);
+#endif
+    }
+
+    void *trackedNew(size_t size) {
+        AllocationTracker::recordAllocation(size);
+        void *result = rawMalloc(size == 0 ? 1 : size);
+        if (result == nullptr) {
+            throw std::bad_alloc();
+        }
+        return result;
+    }
+
+    void *trackedNewNoThrow(size_t size) noexcept {
+        AllocationTracker::recordAllocation(size);
+        return rawMalloc(size == 0 ? 1 : size);
+    }
+}
+
+
+AllocationTracker::AudioThreadScope::AudioThreadScope(const char *tag) {
+    this->previousTag = currentTag;
+    currentTag = tag;
+}
+
+AllocationTracker::AudioThreadScope::~AudioThreadScope() {
+    currentTag = this->previousTag;
+}
+
+
+void AllocationTracker::recordAllocation(size_t size) {
+    const char *tag = currentTag;
+    if (tag == nullptr) {
+        return;
+    }
+
+    numAllocations++;
+
+    for (int i = 0; i < MAX_TAGS; i++) {
+        auto &slot = tagCounts[i];
+        const char *slotTag = slot.tag.load();
+        if (slotTag == nullptr) {
+            if (slot.tag.compare_exchange_strong(slotTag, tag)) {
+                slotTag = tag;
+            }
+        }
+
+        if (slotTag == tag || i == MAX_TAGS - 1) {
+            slot.count++;
+            slot.bytes += size;
+            return;
+        }
+    }
+}
+
+int AllocationTracker::getNumAllocations() {
+    return numAllocations.load();
+}
+
+void AllocationTracker::report() {
+    for (auto &slot : tagCounts) {
+        const char *tag = slot.tag.load();
+        auto count = slot.count.exchange(0);
+        auto bytes = slot.bytes.exchange(0);
+        if (tag != nullptr && count > 0) {
+            DBG("LibreArp: " << count << " audio thread allocation(s) (" << (int64) bytes << " bytes) in " << tag);
+        }
+    }
+    numAllocations = 0;
+}
+
+void AllocationTracker::reset() {
+    for (auto &slot : tagCounts) {
+        slot.count = 0;
+        slot.bytes = 0;
+    }
+    numAllocations = 0;
+}
+
+
+void *operator new(size_t size) {
+    return trackedNew(size);
+}
+
+void *operator new[](size_t size) {
+    return trackedNew(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return trackedNewNoThrow(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return trackedNewNoThrow(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    rawFree(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    rawFree(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    rawFree(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    rawFree(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    rawFree(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    rawFree(ptr);
+}
+
+
+#if LIBREARP_TRACK_MALLOC
+// JUCE containers (HeapBlock, Array, MidiBuffer) allocate through malloc directly. Interposing it only takes effect
+// in executables (e.g. test hosts); a dynamically loaded plugin keeps binding to the C library's malloc.
+extern "C" {
+    void *malloc(size_t size) noexcept {
+        AllocationTracker::recordAllocation(size);
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size) noexcept {
+        AllocationTracker::recordAllocation(count * size);
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *ptr, size_t size) noexcept {
+        AllocationTracker::recordAllocation(size);
+        return __libc_realloc(ptr, size);
+    }
+
+    void free(void *ptr) noexcept {
+        __libc_free(ptr);
+    }
+}
+#endif
+
+#endif
@@ -0,0 +1,110 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include "JuceHeader.h"
+
+/**
+ * Whether heap allocations performed on the audio thread should be tracked. Meant for debug and test builds only, as
+ * it replaces the global operator new and delete (and, on glibc, malloc and friends in executables).
+ */
+#ifndef LIBREARP_TRACK_ALLOCATIONS
+#define LIBREARP_TRACK_ALLOCATIONS 0
+#endif
+
+#if LIBREARP_TRACK_ALLOCATIONS
+
+/**
+ * Tracker of heap allocations performed on the audio thread.
+ *
+ * Audio thread code is marked with AudioThreadScope objects (usually through the LIBREARP_AUDIO_THREAD_SCOPE macro),
+ * each with a tag. Any allocation made while a scope is active is counted against the tag of the innermost scope. The
+ * tracker itself never allocates, so the counts may be read and reported from any thread.
+ */
+class AllocationTracker {
+public:
+
+    /**
+     * The maximum number of distinct tags the tracker keeps counts for. Allocations with further tags are counted
+     * against the last slot.
+     */
+    static constexpr int MAX_TAGS = 32;
+
+
+
+    /**
+     * Marks the current thread as the audio thread for the lifetime of the object.
+     */
+    class AudioThreadScope {
+    public:
+
+        /**
+         * Enters an audio thread scope.
+         *
+         * @param tag the tag allocations within the scope are reported with. Must be a string literal.
+         */
+        explicit AudioThreadScope(const char *tag);
+
+        /**
+         * Leaves the scope, restoring the tag of the enclosing one.
+         */
+        ~AudioThreadScope();
+
+    private:
+
+        /**
+         * The tag of the enclosing scope.
+         */
+        const char *previousTag;
+    };
+
+
+
+    /**
+     * Records an allocation of the specified size, if an audio thread scope is active on the current thread.
+     *
+     * @param size the size of the allocation in bytes
+     */
+    static void recordAllocation(size_t size);
+
+    /**
+     * Gets the total number of allocations recorded on the audio thread.
+     *
+     * @return the total number of recorded allocations
+     */
+    static int getNumAllocations();
+
+    /**
+     * Writes the recorded allocation counts per tag into the debug log and resets them.
+     */
+    static void report();
+
+    /**
+     * Resets all the recorded allocation counts.
+     */
+    static void reset();
+};
+
+#define LIBREARP_AUDIO_THREAD_SCOPE(tag) \
+        AllocationTracker::AudioThreadScope JUCE_JOIN_MACRO(audioThreadScope_, __LINE__)(tag)
+
+#else
+
+#define LIBREARP_AUDIO_THREAD_SCOPE(tag)
+
+#endif
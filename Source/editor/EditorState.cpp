@@ -20,14 +20,19 @@
 const Identifier EditorState::TREEID_EDITOR_STATE = Identifier("editorState"); // NOLINT
 const Identifier EditorState::TREEID_WIDTH = Identifier("width"); // NOLINT
 const Identifier EditorState::TREEID_HEIGHT = Identifier("height"); // NOLINT
+const Identifier EditorState::TREEID_FRAME_RATE = Identifier("frameRate"); // NOLINT
 const Identifier EditorState::TREEID_DIVISOR = Identifier("divisor"); // NOLINT
 const Identifier EditorState::TREEID_LAST_NOTE_LENGTH = Identifier("lastNoteLength"); // NOLINT
 const Identifier EditorState::TREEID_PIXELS_PER_BEAT = Identifier("pixelsPerBeat"); // NOLINT
 const Identifier EditorState::TREEID_PIXELS_PER_NOTE = Identifier("pixelsPerNote"); // NOLINT
 
+const int EditorState::MIN_FRAME_RATE = 1;
+const int EditorState::MAX_FRAME_RATE = 240;
+
 EditorState::EditorState() {
     this->width = 640;
     this->height = 480;
+    this->frameRate = 30;
     this->divisor = 4;
     this->lastNoteLength = -1;
     this->pixelsPerBeat = 100;
@@ -39,6 +44,7 @@ ValueTree EditorState::toValueTree() {
     ValueTree tree = ValueTree(TREEID_EDITOR_STATE);
     tree.setProperty(TREEID_WIDTH, this->width, nullptr);
     tree.setProperty(TREEID_HEIGHT, this->height, nullptr);
+    tree.setProperty(TREEID_FRAME_RATE, this->frameRate, nullptr);
     tree.setProperty(TREEID_DIVISOR, this->divisor, nullptr);
     tree.setProperty(TREEID_LAST_NOTE_LENGTH, this->lastNoteLength, nullptr);
     tree.setProperty(TREEID_PIXELS_PER_BEAT, this->pixelsPerBeat, nullptr);
@@ -58,6 +64,9 @@ EditorState EditorState::fromValueTree(ValueTree &tree) {
     if (tree.hasProperty(TREEID_HEIGHT)) {
         result.height = tree.getProperty(TREEID_HEIGHT);
     }
+    if (tree.hasProperty(TREEID_FRAME_RATE)) {
+        result.frameRate = tree.getProperty(TREEID_FRAME_RATE);
+    }
     if (tree.hasProperty(TREEID_DIVISOR)) {
         result.divisor = tree.getProperty(TREEID_DIVISOR);
     }
@@ -72,3 +81,18 @@ EditorState EditorState::fromValueTree(ValueTree &tree) {
     }
     return result;
 }
+
+
+bool EditorState::operator==(const EditorState &other) const {
+    return this->width == other.width
+            && this->height == other.height
+            && this->frameRate == other.frameRate
+            && this->divisor == other.divisor
+            && this->lastNoteLength == other.lastNoteLength
+            && this->pixelsPerBeat == other.pixelsPerBeat
+            && this->pixelsPerNote == other.pixelsPerNote;
+}
+
+bool EditorState::operator!=(const EditorState &other) const {
+    return !(*this == other);
+}
@@ -26,16 +26,21 @@ public:
     static const Identifier TREEID_EDITOR_STATE;
     static const Identifier TREEID_WIDTH;
     static const Identifier TREEID_HEIGHT;
+    static const Identifier TREEID_FRAME_RATE;
     static const Identifier TREEID_DIVISOR;
     static const Identifier TREEID_LAST_NOTE_LENGTH;
     static const Identifier TREEID_PIXELS_PER_BEAT;
     static const Identifier TREEID_PIXELS_PER_NOTE;
 
+    static const int MIN_FRAME_RATE;
+    static const int MAX_FRAME_RATE;
+
     EditorState();
 
     // Main
     int width;
     int height;
+    int frameRate;
 
     // Pattern editor
     int divisor;
@@ -46,6 +51,9 @@ public:
     ValueTree toValueTree();
     static EditorState fromValueTree(ValueTree &tree);
 
+    bool operator==(const EditorState &other) const;
+    bool operator!=(const EditorState &other) const;
+
 };
 
 
@@ -30,7 +30,9 @@ MainEditor::MainEditor(LibreArp &p, EditorState &e)
           resizer(this, &boundsConstrainer),
           tabs(TabbedButtonBar::Orientation::TabsAtTop),
           patternEditor(p, e),
-          xmlEditor(p) {
+          xmlEditor(p),
+          frameRate(0),
+          lastPlaybackVersion(0) {
 
     LookAndFeel::setDefaultLookAndFeel(&LArpLookAndFeel::getInstance());
 
@@ -52,6 +54,8 @@ MainEditor::MainEditor(LibreArp &p, EditorState &e)
 
     addAndMakeVisible(tabs);
     addAndMakeVisible(resizer, 9999);
+
+    updateFrameRate();
 }
 
 MainEditor::~MainEditor() = default;
@@ -68,3 +72,22 @@ void MainEditor::resized() {
     tabs.setBounds(getLocalBounds().reduced(8));
     resizer.setBounds(getWidth() - RESIZER_SIZE, getHeight() - RESIZER_SIZE, RESIZER_SIZE, RESIZER_SIZE);
 }
+
+void MainEditor::timerCallback() {
+    updateFrameRate();
+    processor.reclaimEvents();
+
+    auto &playback = processor.getPlaybackSnapshot();
+    if (playback.version != lastPlaybackVersion) {
+        lastPlaybackVersion = playback.version;
+        patternEditor.repaint();
+    }
+}
+
+void MainEditor::updateFrameRate() {
+    auto newFrameRate = jlimit(EditorState::MIN_FRAME_RATE, EditorState::MAX_FRAME_RATE, state.frameRate);
+    if (newFrameRate != frameRate) {
+        frameRate = newFrameRate;
+        startTimerHz(frameRate);
+    }
+}
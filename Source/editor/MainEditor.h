@@ -28,7 +28,7 @@
 /**
  * Main LibreArp editor component.
  */
-class MainEditor : public AudioProcessorEditor {
+class MainEditor : public AudioProcessorEditor, private Timer {
 public:
 
     explicit MainEditor(LibreArp &, EditorState &);
@@ -41,6 +41,18 @@ public:
     void resized() override;
 
 private:
+
+    /**
+     * Polls the playback state and repaints the pattern editor if it has changed, and has the events playback has
+     * stopped using deleted.
+     */
+    void timerCallback() override;
+
+    /**
+     * Restarts the timer if the frame rate in the editor state has changed since it was last started.
+     */
+    void updateFrameRate();
+
     LibreArp &processor;
     EditorState &state;
 
@@ -54,5 +66,8 @@ private:
     XmlEditor xmlEditor;
     AboutBox aboutBox;
 
+    int frameRate;
+    uint64 lastPlaybackVersion;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainEditor);
 };
@@ -36,7 +36,7 @@ BeatBar::BeatBar(LibreArp &p, EditorState &e, PatternEditorView *ec)
 }
 
 void BeatBar::paint(Graphics &g) {
-    auto pattern = processor.getPattern();
+    auto pattern = processor.getPatternSnapshot();
     auto pixelsPerBeat = state.pixelsPerBeat;
 
     setSize(jmax(editorComponent->getRenderWidth(), getParentWidth()), getParentHeight());
@@ -47,7 +47,8 @@ void BeatBar::paint(Graphics &g) {
     g.setColour(BOTTOM_LINE_COLOUR);
     g.drawLine(0, getHeight(), getWidth(), getHeight());
 
-    auto loopLine = static_cast<int>((pattern.loopLength / static_cast<float>(pattern.getTimebase())) * pixelsPerBeat);
+    auto loopLine = static_cast<int>(
+            (pattern->loopLength / static_cast<float>(pattern->getTimebase())) * pixelsPerBeat);
 
     // Draw beat lines
     g.setFont(20);
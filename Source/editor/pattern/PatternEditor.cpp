@@ -52,7 +52,7 @@ PatternEditor::PatternEditor(LibreArp &p, EditorState &e, PatternEditorView *ec)
     cursorPulse = 0;
     dragAction = nullptr;
     if (state.lastNoteLength < 1) {
-        state.lastNoteLength = processor.getPattern().getTimebase() / state.divisor;
+        state.lastNoteLength = processor.getPatternSnapshot()->getTimebase() / state.divisor;
     }
     snapEnabled = true;
     selection = Rectangle<int>(0, 0, 0, 0);
@@ -66,7 +66,9 @@ PatternEditor::~PatternEditor() {
 }
 
 void PatternEditor::paint(Graphics &g) {
-    ArpPattern &pattern = processor.getPattern();
+    auto snapshot = processor.getPatternSnapshot();
+    auto &pattern = *snapshot;
+    auto &playback = processor.getPlaybackSnapshot();
     auto pixelsPerBeat = state.pixelsPerBeat;
     auto pixelsPerNote = state.pixelsPerNote;
 
@@ -80,15 +82,15 @@ void PatternEditor::paint(Graphics &g) {
     g.fillRect(getLocalBounds());
 
     // Draw bars
-    auto beat = (pixelsPerBeat * 4) / processor.getTimeSigDenominator();
-    auto bar = beat * processor.getTimeSigNumerator();
+    auto beat = (pixelsPerBeat * 4) / playback.timeSigDenominator;
+    auto bar = beat * playback.timeSigNumerator;
     g.setColour(BAR_SHADE_COLOUR);
     for (int i = 0; i < getWidth(); i += bar * 2) {
         g.fillRect(i + bar, 0, bar, getHeight());
     }
 
     // Draw octave 0
-    auto numInputNotes = processor.getNumInputNotes();
+    auto numInputNotes = playback.numInputNotes;
     int noteZeroY = noteToY(0);
     if (numInputNotes > 0) {
         g.setColour(ZERO_OCTAVE_COLOUR);
@@ -134,7 +136,7 @@ void PatternEditor::paint(Graphics &g) {
         auto &note = notes[i];
         Rectangle<int> noteRect = getRectangleForNote(note);
 
-        auto isPlaying = processor.getPlayingPatternIndices().contains(i);
+        auto isPlaying = playback.isNotePlaying(i);
 
         if (selectedNotes.find(i) == selectedNotes.end()) {
             g.setColour(isPlaying ? NOTE_ACTIVE_FILL_COLOUR : NOTE_FILL_COLOUR);
@@ -157,7 +159,7 @@ void PatternEditor::paint(Graphics &g) {
     g.drawLine(loopLine, 0, loopLine, getHeight(), 4);
 
     // Draw position indicator
-    auto position = processor.getLastPosition();
+    auto position = playback.position;
     if (position > 0) {
         g.setColour(POSITION_INDICATOR_COLOUR);
         if (processor.getLoopReset() > 0.0) {
@@ -199,11 +201,11 @@ void PatternEditor::mouseWheelMove(const MouseEvent &event, const MouseWheelDeta
 }
 
 void PatternEditor::mouseMove(const MouseEvent &event) {
-    auto &pattern = processor.getPattern();
+    auto snapshot = processor.getPatternSnapshot();
 
     mouseAnyMove(event);
 
-    auto &notes = pattern.getNotes();
+    auto &notes = snapshot->getNotes();
     for (uint64 i = 0; i < notes.size(); i++) {
         auto &note = notes[i];
         auto noteRect = getRectangleForNote(note);
@@ -310,7 +312,7 @@ void PatternEditor::mouseDown(const MouseEvent &event) {
                         if (selectedNotes.empty()) {
                             auto &offsets = ((NoteDragAction *) this->dragAction)->noteOffsets;
                             if (offsets.size() == 1) {
-                                auto &note = processor.getPattern().getNotes()[offsets[0].noteIndex];
+                                auto &note = processor.getPatternSnapshot()->getNotes()[offsets[0].noteIndex];
                                 state.lastNoteLength = note.endPoint - note.startPoint;
                             }
                         }
@@ -394,7 +396,7 @@ bool PatternEditor::keyPressed(const KeyPress &key) {
 
 void PatternEditor::loopResize(const MouseEvent &event) {
     int64 lastNoteEnd = 0;
-    for (auto &note : processor.getPattern().getNotes()) {
+    for (auto &note : processor.getPatternSnapshot()->getNotes()) {
         if (note.endPoint > lastNoteEnd) {
             lastNoteEnd = note.endPoint;
         }
@@ -419,7 +421,7 @@ void PatternEditor::noteStartResize(const MouseEvent &event, NoteDragAction *dra
         state.lastNoteLength = note.endPoint - note.startPoint;
     }
 
-    processor.buildPattern();
+    processor.buildPattern(dragAction->getNoteIndices());
     repaint();
     setMouseCursor(MouseCursor::LeftEdgeResizeCursor);
 }
@@ -438,7 +440,7 @@ void PatternEditor::noteEndResize(const MouseEvent &event, NoteDragAction *dragA
         state.lastNoteLength = note.endPoint - note.startPoint;
     }
 
-    processor.buildPattern();
+    processor.buildPattern(dragAction->getNoteIndices());
     repaint();
     setMouseCursor(MouseCursor::RightEdgeResizeCursor);
 }
@@ -462,7 +464,7 @@ void PatternEditor::noteMove(const MouseEvent &event, PatternEditor::NoteDragAct
         }
     }
 
-    processor.buildPattern();
+    processor.buildPattern(dragAction->getNoteIndices());
     repaint();
 
     setMouseCursor(MouseCursor::DraggingHandCursor);
@@ -503,31 +505,27 @@ void PatternEditor::noteCreate(const MouseEvent &event) {
 }
 
 void PatternEditor::noteDelete(const MouseEvent &event) {
-    auto &pattern = processor.getPattern();
-    auto &notes = pattern.getNotes();
-    bool erased = false;
+    auto snapshot = processor.getPatternSnapshot();
+    auto &notes = snapshot->getNotes();
 
-    for (auto it = notes.begin(); it != notes.end(); it++) {
-        auto &note = *it;
-        auto noteRect = getRectangleForNote(note);
+    for (uint64 i = 0; i < notes.size(); i++) {
+        auto noteRect = getRectangleForNote(notes[i]);
 
         if (noteRect.contains(event.x, event.y)) {
-            notes.erase(it);
-            erased = true;
+            auto &patternNotes = processor.getPattern().getNotes();
+            patternNotes.erase(patternNotes.begin() + i);
             setDragAction(nullptr);
-            break;
+            processor.buildPattern();
+            repaint();
+            return;
         }
     }
-
-    if (erased) {
-        processor.buildPattern();
-        repaint();
-    }
 }
 
 
 void PatternEditor::selectAll() {
-    auto &notes = processor.getPattern().getNotes();
+    auto snapshot = processor.getPatternSnapshot();
+    auto &notes = snapshot->getNotes();
     for (int i = 0; i < notes.size(); i++) {
         selectedNotes.insert(i);
     }
@@ -556,12 +554,12 @@ void PatternEditor::moveSelectedUp(bool octave) {
     auto &notes = processor.getPattern().getNotes();
     for (auto index : selectedNotes) {
         if (octave) {
-            notes[index].data.noteNumber += processor.getNumInputNotes();
+            notes[index].data.noteNumber += processor.getPlaybackSnapshot().numInputNotes;
         } else {
             notes[index].data.noteNumber++;
         }
     }
-    processor.buildPattern();
+    processor.buildPattern(std::vector<uint64>(selectedNotes.begin(), selectedNotes.end()));
     repaint();
 }
 
@@ -569,12 +567,12 @@ void PatternEditor::moveSelectedDown(bool octave) {
     auto &notes = processor.getPattern().getNotes();
     for (auto index : selectedNotes) {
         if (octave) {
-            notes[index].data.noteNumber -= processor.getNumInputNotes();
+            notes[index].data.noteNumber -= processor.getPlaybackSnapshot().numInputNotes;
         } else {
             notes[index].data.noteNumber--;
         }
     }
-    processor.buildPattern();
+    processor.buildPattern(std::vector<uint64>(selectedNotes.begin(), selectedNotes.end()));
     repaint();
 }
 
@@ -586,7 +584,8 @@ void PatternEditor::select(const MouseEvent &event, PatternEditor::SelectionDrag
         selectedNotes.clear();
     }
 
-    auto &notes = processor.getPattern().getNotes();
+    auto snapshot = processor.getPatternSnapshot();
+    auto &notes = snapshot->getNotes();
     for(int i = 0; i < notes.size(); i++) {
         auto &note = notes[i];
         auto noteRect = getRectangleForNote(note);
@@ -602,8 +601,7 @@ PatternEditorView* PatternEditor::getView() {
 }
 
 
-Rectangle<int> PatternEditor::getRectangleForNote(ArpNote &note) {
-    ArpPattern &pattern = processor.getPattern();
+Rectangle<int> PatternEditor::getRectangleForNote(const ArpNote &note) {
     auto pixelsPerNote = state.pixelsPerNote;
 
     return Rectangle<int>(
@@ -614,7 +612,7 @@ Rectangle<int> PatternEditor::getRectangleForNote(ArpNote &note) {
 }
 
 Rectangle<int> PatternEditor::getRectangleForLoop() {
-    auto loopLine = pulseToX(processor.getPattern().loopLength);
+    auto loopLine = pulseToX(processor.getPatternSnapshot()->loopLength);
     return Rectangle<int>(loopLine - LOOP_RESIZE_TOLERANCE, 0, LOOP_RESIZE_TOLERANCE * 2, getHeight());
 }
 
@@ -624,8 +622,7 @@ int64 PatternEditor::snapPulse(int64 pulse, bool floor) {
         return pulse;
     }
 
-    auto &pattern = processor.getPattern();
-    auto timebase = pattern.getTimebase();
+    auto timebase = processor.getPatternSnapshot()->getTimebase();
     double doubleDivisor = state.divisor;
 
     double base = (pulse * doubleDivisor) / timebase;
@@ -636,8 +633,7 @@ int64 PatternEditor::snapPulse(int64 pulse, bool floor) {
 
 
 int64 PatternEditor::xToPulse(int x, bool snap, bool floor) {
-    auto &pattern = processor.getPattern();
-    auto timebase = pattern.getTimebase();
+    auto timebase = processor.getPatternSnapshot()->getTimebase();
     double pixelsPerBeat = state.pixelsPerBeat;
 
     auto pulse = static_cast<int64>(
@@ -652,10 +648,10 @@ int PatternEditor::yToNote(int y) {
 }
 
 int PatternEditor::pulseToX(int64 pulse) {
-    auto &pattern = processor.getPattern();
+    auto timebase = processor.getPatternSnapshot()->getTimebase();
     auto pixelsPerBeat = state.pixelsPerBeat;
 
-    return static_cast<int>((pulse / static_cast<float>(pattern.getTimebase())) * pixelsPerBeat);
+    return static_cast<int>((pulse / static_cast<float>(timebase)) * pixelsPerBeat);
 }
 
 int PatternEditor::noteToY(int note) {
@@ -680,7 +676,7 @@ PatternEditor::NoteDragAction::NoteDragAction(
         PatternEditor *editor,
         uint8 type,
         uint64 index,
-        std::vector<ArpNote> &allNotes,
+        const std::vector<ArpNote> &allNotes,
         const MouseEvent &event,
         bool offset)
         :
@@ -696,7 +692,7 @@ PatternEditor::NoteDragAction::NoteDragAction(
         uint8 type,
         uint64 initiatorIndex,
         std::set<uint64> &indices,
-        std::vector<ArpNote> &allNotes,
+        const std::vector<ArpNote> &allNotes,
         const MouseEvent &event,
         bool offset)
         :
@@ -709,9 +705,18 @@ PatternEditor::NoteDragAction::NoteDragAction(
     }
 }
 
+std::vector<uint64> PatternEditor::NoteDragAction::getNoteIndices() const {
+    std::vector<uint64> result;
+    result.reserve(noteOffsets.size());
+    for (auto &noteOffset : noteOffsets) {
+        result.push_back(noteOffset.noteIndex);
+    }
+    return result;
+}
+
 PatternEditor::NoteDragAction::NoteOffset PatternEditor::NoteDragAction::createOffset(
         PatternEditor *editor,
-        std::vector<ArpNote> &allNotes,
+        const std::vector<ArpNote> &allNotes,
         uint64 noteIndex,
         const MouseEvent &event) {
 
@@ -122,7 +122,7 @@ class PatternEditor : public Component {
                 PatternEditor *editor,
                 uint8 type,
                 uint64 index,
-                std::vector<ArpNote> &allNotes,
+                const std::vector<ArpNote> &allNotes,
                 const MouseEvent &event,
                 bool offset = true);
 
@@ -142,10 +142,17 @@ class PatternEditor : public Component {
                 uint8 type,
                 uint64 initiatorIndex,
                 std::set<uint64> &indices,
-                std::vector<ArpNote> &allNotes,
+                const std::vector<ArpNote> &allNotes,
                 const MouseEvent &event,
                 bool offset = true);
 
+        /**
+         * Gets the indices of the dragged notes.
+         *
+         * @return the indices of the dragged notes
+         */
+        std::vector<uint64> getNoteIndices() const;
+
         /**
          * The offsets of notes relative to the cursor.
          */
@@ -168,7 +175,7 @@ class PatternEditor : public Component {
          *
          * @return the calculated offset
          */
-        static NoteOffset createOffset(PatternEditor *editor, std::vector<ArpNote> &allNotes, uint64 noteIndex, const MouseEvent &event);
+        static NoteOffset createOffset(PatternEditor *editor, const std::vector<ArpNote> &allNotes, uint64 noteIndex, const MouseEvent &event);
     };
 
     /**
@@ -395,7 +402,7 @@ private:
      * @param note the note
      * @return the rectangle in the canvas that the specified note is rendered in
      */
-    Rectangle<int> getRectangleForNote(ArpNote &note);
+    Rectangle<int> getRectangleForNote(const ArpNote &note);
 
     /**
      * Gets the active rectangle in the canvas of the loop that reacts to mouse events.
@@ -23,6 +23,8 @@ const int Y_ZOOM_RATE = 30;
 PatternEditorView::PatternEditorView(LibreArp &p, EditorState &e)
         : processor(p),
           state(e),
+          noteRangeVersion(0),
+          noteRange(0),
           beatBar(p, state, this),
           editor(p, state, this) {
 
@@ -61,6 +63,20 @@ PatternEditorView::PatternEditorView(LibreArp &p, EditorState &e)
     snapSliderLabel.setText("Snap:", NotificationType::dontSendNotification);
     snapSliderLabel.setJustificationType(Justification::centredRight);
     addAndMakeVisible(snapSliderLabel);
+
+    // The main editor picks up the new frame rate on its next frame
+    frameRateSlider.setSliderStyle(Slider::SliderStyle::IncDecButtons);
+    frameRateSlider.setRange(EditorState::MIN_FRAME_RATE, EditorState::MAX_FRAME_RATE, 1);
+    frameRateSlider.setValue(state.frameRate, NotificationType::dontSendNotification);
+    frameRateSlider.setTextBoxStyle(Slider::TextEntryBoxPosition::TextBoxLeft, false, 32, 24);
+    frameRateSlider.onValueChange = [this] {
+        state.frameRate = static_cast<int>(frameRateSlider.getValue());
+    };
+    addAndMakeVisible(frameRateSlider);
+
+    frameRateSliderLabel.setText("Refresh (Hz):", NotificationType::dontSendNotification);
+    frameRateSliderLabel.setJustificationType(Justification::centredRight);
+    addAndMakeVisible(frameRateSliderLabel);
 }
 
 void PatternEditorView::paint(Graphics &g) {
@@ -77,6 +93,9 @@ void PatternEditorView::resized() {
     loopResetSlider.setBounds(toolBarArea.removeFromLeft(96));
     snapSlider.setBounds(toolBarArea.removeFromRight(96));
     snapSliderLabel.setBounds(toolBarArea.removeFromRight(64));
+    frameRateSlider.setBounds(toolBarArea.removeFromRight(96));
+    auto frameRateLabelWidth = frameRateSliderLabel.getFont().getStringWidth(frameRateSliderLabel.getText());
+    frameRateSliderLabel.setBounds(toolBarArea.removeFromRight(8 + frameRateLabelWidth));
 
     beatBarViewport.setBounds(area.removeFromTop(20));
     editorViewport.setBounds(area);
@@ -98,21 +117,26 @@ void PatternEditorView::zoomPattern(float deltaX, float deltaY) {
 
 
 int PatternEditorView::getRenderWidth() {
-    auto &pattern = processor.getPattern();
+    auto pattern = processor.getPatternSnapshot();
     return static_cast<int>(
-            (3 + pattern.loopLength / static_cast<double>(pattern.getTimebase())) * state.pixelsPerBeat);
+            (3 + pattern->loopLength / static_cast<double>(pattern->getTimebase())) * state.pixelsPerBeat);
 }
 
 int PatternEditorView::getRenderHeight() {
-    auto &pattern = processor.getPattern();
-
-    int dist = 0;
-    for (auto &note : pattern.getNotes()) {
-        if (std::abs(note.data.noteNumber) > dist) {
-            dist = std::abs(note.data.noteNumber);
+    auto version = processor.getPatternVersion();
+    if (version != noteRangeVersion) {
+        auto pattern = processor.getPatternSnapshot();
+
+        noteRange = 0;
+        for (auto &note : pattern->getNotes()) {
+            if (std::abs(note.data.noteNumber) > noteRange) {
+                noteRange = std::abs(note.data.noteNumber);
+            }
         }
+        noteRangeVersion = version;
     }
-    dist = 1 + (dist + 3) * 2;
+
+    int dist = 1 + (noteRange + 3) * 2;
 
     return dist * state.pixelsPerNote;
 }
@@ -42,12 +42,19 @@ private:
     LibreArp &processor;
     EditorState &state;
 
+    // The largest note distance from zero in the pattern, cached for the pattern version it was computed for
+    uint64 noteRangeVersion;
+    int noteRange;
+
     Slider snapSlider;
     Label snapSliderLabel;
 
     Slider loopResetSlider;
     Label loopResetSliderLabel;
 
+    Slider frameRateSlider;
+    Label frameRateSliderLabel;
+
     Viewport editorViewport;
     PatternEditor editor;
 
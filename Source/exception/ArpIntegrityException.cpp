@@ -21,5 +21,21 @@
 #include <stdexcept>
 
 ArpIntegrityException::ArpIntegrityException(std::string message) : std::runtime_error(message) {
+    this->line = 0;
+    this->column = 0;
+}
+
+ArpIntegrityException::ArpIntegrityException(const std::string &message, int line, int column)
+        : std::runtime_error(message + " (line " + std::to_string(line) + ", column " + std::to_string(column) + ")") {
+
+    this->line = line;
+    this->column = column;
+}
+
+int ArpIntegrityException::getLine() const {
+    return this->line;
+}
 
+int ArpIntegrityException::getColumn() const {
+    return this->column;
 }
@@ -24,6 +24,33 @@
 class ArpIntegrityException : public std::runtime_error {
 public:
     explicit ArpIntegrityException(std::string message);
+
+    /**
+     * Constructs an exception for malformed text input, with the position of the error appended to the message.
+     *
+     * @param message the description of the error
+     * @param line the line of the error, starting at 1
+     * @param column the column of the error, starting at 1
+     */
+    ArpIntegrityException(const std::string &message, int line, int column);
+
+    /**
+     * Gets the line of the error in text input.
+     *
+     * @return the line of the error starting at 1, or 0 if the error is not in text input
+     */
+    int getLine() const;
+
+    /**
+     * Gets the column of the error in text input.
+     *
+     * @return the column of the error starting at 1, or 0 if the error is not in text input
+     */
+    int getColumn() const;
+
+private:
+    int line;
+    int column;
 };
 
 
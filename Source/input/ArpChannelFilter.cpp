@@ -0,0 +1,37 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "ArpChannelFilter.h"
+
+ArpChannelFilter::ArpChannelFilter() {
+    this->channel = 0;
+}
+
+
+ArpInputStage::Action ArpChannelFilter::process(Note &note) {
+    return (this->channel == 0 || note.channel == this->channel) ? CONTINUE : PASS_THROUGH;
+}
+
+
+int ArpChannelFilter::getChannel() const {
+    return this->channel;
+}
+
+void ArpChannelFilter::setChannel(int channel) {
+    jassert(channel >= 0 && channel <= 16);
+    this->channel = channel;
+}
@@ -0,0 +1,60 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include "ArpInputStage.h"
+
+/**
+ * An input stage passing the notes from all the other channels than the input channel through to the host.
+ */
+class ArpChannelFilter : public ArpInputStage {
+public:
+
+    /**
+     * Constructs a channel filter reading notes from all channels.
+     */
+    ArpChannelFilter();
+
+
+
+    Action process(Note &note) override;
+
+
+
+    /**
+     * Gets the MIDI channel input notes are read from.
+     *
+     * @return the MIDI channel input notes are read from
+     */
+    int getChannel() const;
+
+    /**
+     * Sets the MIDI channel input notes are read from.
+     *
+     * @param channel the MIDI channel input notes are read from. An integer from range 0-16. Notes from all channels
+     * are read if zero.
+     */
+    void setChannel(int channel);
+
+private:
+
+    /**
+     * The MIDI channel input notes are read from. Notes from all channels are read if zero.
+     */
+    int channel;
+};
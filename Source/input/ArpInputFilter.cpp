@@ -0,0 +1,46 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "ArpInputFilter.h"
+
+ArpInputFilter::ArpInputFilter() {
+    for (auto &stage : this->stages) {
+        stage = nullptr;
+    }
+    this->numStages = 0;
+}
+
+
+void ArpInputFilter::addStage(ArpInputStage &stage) {
+    jassert(this->numStages < MAX_STAGES);
+    this->stages[this->numStages++] = &stage;
+}
+
+void ArpInputFilter::reset() {
+    for (int i = 0; i < this->numStages; i++) {
+        this->stages[i]->reset();
+    }
+}
+
+
+ArpInputStage::Action ArpInputFilter::feed(ArpInputStage::Note &note) {
+    auto action = ArpInputStage::CONTINUE;
+    for (int i = 0; i < this->numStages && action == ArpInputStage::CONTINUE; i++) {
+        action = this->stages[i]->process(note);
+    }
+    return action;
+}
@@ -0,0 +1,139 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <cstring>
+#include "JuceHeader.h"
+#include "ArpInputStage.h"
+#include "../ArpMidiBufferLayout.h"
+
+/**
+ * The input filter pipeline of the engine.
+ *
+ * Every note message of the MIDI buffer is fed through the stages in order, and unless a stage passes it through or
+ * discards it, handed over to the caller along with its sample position. The consumed and discarded messages are
+ * removed by compacting the raw data of the MIDI buffer in place, so the messages passed through to the host are
+ * neither copied nor reallocated when there is nothing to remove before them.
+ */
+class ArpInputFilter {
+public:
+
+    /**
+     * The maximum number of stages.
+     */
+    static constexpr int MAX_STAGES = 8;
+
+    /**
+     * Constructs a pipeline with no stages.
+     */
+    ArpInputFilter();
+
+
+
+    /**
+     * Appends a stage to the pipeline. The stage is not owned by the pipeline.
+     *
+     * @param stage the stage to append
+     */
+    void addStage(ArpInputStage &stage);
+
+    /**
+     * Feeds the note messages of the MIDI buffer through the stages, consumes them and removes them from the buffer.
+     *
+     * @param midi the MIDI buffer of the current block
+     * @param onConsume the function called as onConsume(sample, note) for every consumed note message, in time order
+     */
+    template <typename ConsumeCallback>
+    void process(MidiBuffer &midi, ConsumeCallback &&onConsume);
+
+    /**
+     * Resets the state of all the stages.
+     */
+    void reset();
+
+private:
+
+    /**
+     * The stages of the pipeline, in order.
+     */
+    ArpInputStage *stages[MAX_STAGES];
+
+    /**
+     * The number of stages.
+     */
+    int numStages;
+
+
+
+    /**
+     * Feeds a note message through the stages.
+     *
+     * @param note the note message
+     * @return the action of the last stage the message has reached
+     */
+    ArpInputStage::Action feed(ArpInputStage::Note &note);
+
+    JUCE_DECLARE_NON_COPYABLE(ArpInputFilter);
+};
+
+
+
+template <typename ConsumeCallback>
+void ArpInputFilter::process(MidiBuffer &midi, ConsumeCallback &&onConsume) {
+    auto &data = ArpMidiBufferLayout::getData(midi);
+    auto begin = data.begin();
+    auto end = data.end();
+
+    auto read = begin;
+    auto write = begin;
+    while (read < end) {
+        auto total = ArpMidiBufferLayout::getTotalSize(read);
+        auto size = total - ArpMidiBufferLayout::HEADER_SIZE;
+        auto message = read + ArpMidiBufferLayout::HEADER_SIZE;
+        auto sample = static_cast<int>(ArpMidiBufferLayout::getTime(read));
+
+        auto status = message[0] & 0xF0;
+        auto isNote = size >= 3 && (status == 0x80 || status == 0x90);
+
+        auto action = ArpInputStage::PASS_THROUGH;
+        if (isNote) {
+            ArpInputStage::Note note; // NOLINT
+            note.channel = (message[0] & 0x0F) + 1;
+            note.note = message[1] & 0x7F;
+            note.isNoteOn = status == 0x90 && message[2] != 0;
+            note.velocity = note.isNoteOn ? (message[2] & 0x7F) : 0;
+
+            action = feed(note);
+            if (action == ArpInputStage::CONTINUE) {
+                onConsume(sample, static_cast<const ArpInputStage::Note &>(note));
+            }
+        }
+
+        if (action == ArpInputStage::PASS_THROUGH) {
+            if (write != read) {
+                std::memmove(write, read, static_cast<size_t>(total));
+            }
+            write += total;
+        }
+        read += total;
+    }
+
+    if (write != end) {
+        ArpMidiBufferLayout::truncate(midi, static_cast<int>(write - begin));
+    }
+}
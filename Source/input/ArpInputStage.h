@@ -0,0 +1,92 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include "JuceHeader.h"
+
+/**
+ * A stage of the input filter pipeline. Every input note message is fed through the stages in order before it is
+ * consumed into the input notes.
+ */
+class ArpInputStage {
+public:
+
+    /**
+     * What happens to a note message after a stage has processed it.
+     */
+    enum Action {
+        /**
+         * The message is fed to the next stage, or consumed if this is the last one.
+         */
+        CONTINUE,
+
+        /**
+         * The message is left in the MIDI buffer for the host, as is.
+         */
+        PASS_THROUGH,
+
+        /**
+         * The message is removed from the MIDI buffer without being consumed.
+         */
+        DISCARD
+    };
+
+    /**
+     * A note message in the pipeline.
+     */
+    class Note {
+    public:
+
+        /**
+         * The MIDI channel, from 1 to 16.
+         */
+        int channel;
+
+        /**
+         * The MIDI note number. May be changed by a stage.
+         */
+        int note;
+
+        /**
+         * The velocity, from 0 to 127. Zero for note offs.
+         */
+        int velocity;
+
+        /**
+         * Whether the message is a note on.
+         */
+        bool isNoteOn;
+    };
+
+
+
+    virtual ~ArpInputStage() = default;
+
+    /**
+     * Processes a note message. Called on the audio thread, so it must not block nor allocate.
+     *
+     * @param note the note message, which may be modified for the following stages
+     * @return what happens to the message
+     */
+    virtual Action process(Note &note) = 0;
+
+    /**
+     * Resets the state of the stage, as all the input notes are released.
+     */
+    virtual void reset() {}
+};
@@ -0,0 +1,58 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "ArpTranspose.h"
+
+ArpTranspose::ArpTranspose() {
+    this->semitones = 0;
+    reset();
+}
+
+
+ArpInputStage::Action ArpTranspose::process(Note &note) {
+    auto &target = this->transposed[note.note];
+    if (note.isNoteOn) {
+        target = note.note + this->semitones;
+        if (target < 0 || target > 127) {
+            target = NOT_HELD;
+            return DISCARD;
+        }
+        note.note = target;
+    } else {
+        if (target == NOT_HELD) {
+            return DISCARD;
+        }
+        note.note = target;
+        target = NOT_HELD;
+    }
+    return CONTINUE;
+}
+
+void ArpTranspose::reset() {
+    for (auto &note : this->transposed) {
+        note = NOT_HELD;
+    }
+}
+
+
+int ArpTranspose::getSemitones() const {
+    return this->semitones;
+}
+
+void ArpTranspose::setSemitones(int semitones) {
+    this->semitones = semitones;
+}
@@ -0,0 +1,75 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include "ArpInputStage.h"
+
+/**
+ * An input stage transposing the input notes by a number of semitones. Notes transposed out of the MIDI range are
+ * discarded.
+ *
+ * The note off of a note is transposed by the amount its note on has been transposed by, so changing the amount while
+ * notes are held does not leave them stuck.
+ */
+class ArpTranspose : public ArpInputStage {
+public:
+
+    /**
+     * Constructs a stage transposing by zero semitones.
+     */
+    ArpTranspose();
+
+
+
+    Action process(Note &note) override;
+
+    void reset() override;
+
+
+
+    /**
+     * Gets the number of semitones the input notes are transposed by.
+     *
+     * @return the number of semitones
+     */
+    int getSemitones() const;
+
+    /**
+     * Sets the number of semitones the input notes are transposed by.
+     *
+     * @param semitones the number of semitones, negative to transpose down
+     */
+    void setSemitones(int semitones);
+
+private:
+
+    /**
+     * Marks the notes that are not held.
+     */
+    static constexpr int NOT_HELD = -1;
+
+    /**
+     * The number of semitones the input notes are transposed by.
+     */
+    int semitones;
+
+    /**
+     * The transposed note of each held incoming note, or NOT_HELD.
+     */
+    int transposed[128];
+};
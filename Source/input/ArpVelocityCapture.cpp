@@ -0,0 +1,42 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "ArpVelocityCapture.h"
+
+ArpVelocityCapture::ArpVelocityCapture() {
+    reset();
+}
+
+
+ArpInputStage::Action ArpVelocityCapture::process(Note &note) {
+    if (note.isNoteOn) {
+        this->velocities[note.note] = static_cast<uint8>(note.velocity);
+    }
+    return CONTINUE;
+}
+
+void ArpVelocityCapture::reset() {
+    for (auto &velocity : this->velocities) {
+        velocity = DEFAULT_VELOCITY;
+    }
+}
+
+
+int ArpVelocityCapture::getVelocity(int note) const {
+    jassert(note >= 0 && note < 128);
+    return this->velocities[note];
+}
@@ -0,0 +1,60 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include "ArpInputStage.h"
+
+/**
+ * An input stage recording the velocity each input note has been played with.
+ */
+class ArpVelocityCapture : public ArpInputStage {
+public:
+
+    /**
+     * The velocity reported for notes that have never been played.
+     */
+    static constexpr int DEFAULT_VELOCITY = 127;
+
+    /**
+     * Constructs a stage with all the velocities at their default.
+     */
+    ArpVelocityCapture();
+
+
+
+    Action process(Note &note) override;
+
+    void reset() override;
+
+
+
+    /**
+     * Gets the velocity the input note has last been played with.
+     *
+     * @param note the MIDI note number
+     * @return the velocity, from 1 to 127
+     */
+    int getVelocity(int note) const;
+
+private:
+
+    /**
+     * The last velocity of each input note.
+     */
+    uint8 velocities[128];
+};
@@ -0,0 +1,208 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+#include "Benchmark.h"
+
+const int NOTES_PER_BEAT = 8;
+const int NOTE_LENGTH_BEATS_DIVISOR = 2;
+const int NUM_NOTE_NUMBERS = 8;
+const int CHORD_ROOT = 48;
+const int CHORD_INTERVAL = 3;
+const double LOOP_RESET_BEATS = 3.0;
+const int MAX_PATTERN_ITERATIONS = 1000000;
+
+/**
+ * Accumulates results of benchmarked calls, so that the compiler cannot optimize the calls away.
+ */
+static volatile size_t sink;
+
+Benchmark::Result Benchmark::runEngine(const EngineCase &parameters) {
+    ArpEngine engine;
+    auto pattern = createPattern(parameters.numNotes);
+    engine.compile(pattern);
+    engine.setLoopReset(parameters.loopReset ? LOOP_RESET_BEATS : 0.0);
+    engine.setOctaves(parameters.octaves);
+    engine.prepare(this->sampleRate, parameters.blockSize);
+
+    ArpEngine::Transport transport;
+    transport.isPlaying = true;
+    transport.bpm = this->bpm;
+
+    MidiBuffer midi;
+    int64 position = 0;
+    auto process = [&](bool nonRealtime) {
+        transport.ppqPosition = position * this->bpm / (60.0 * this->sampleRate);
+        engine.process(transport, parameters.blockSize, midi, nonRealtime);
+        position += parameters.blockSize;
+    };
+
+    // The first block holds the chord and waits for the pattern to be built
+    for (int i = 0; i < parameters.chordSize; i++) {
+        midi.addEvent(MidiMessage::noteOn(1, CHORD_ROOT + i * CHORD_INTERVAL, 1.0f), 0);
+    }
+    process(true);
+
+    for (int i = 0; i < this->numWarmupBlocks; i++) {
+        midi.clear();
+        process(false);
+    }
+
+    Result result;
+    result.name = "engine";
+    result.parameters = parameters;
+
+    std::vector<double> times;
+    times.reserve(static_cast<size_t>(this->numBlocks));
+    for (int i = 0; i < this->numBlocks; i++) {
+        midi.clear();
+
+        auto start = Time::getHighResolutionTicks();
+        process(false);
+        auto end = Time::getHighResolutionTicks();
+
+        times.push_back(Time::highResolutionTicksToSeconds(end - start) * 1e9);
+        result.numEvents += midi.getNumEvents();
+    }
+
+    computeStatistics(result, times);
+    return result;
+}
+
+Benchmark::Result Benchmark::runBuildEvents(int numNotes) {
+    auto pattern = createPattern(numNotes);
+    return runRepeated("buildEvents", numNotes, [&]() {
+        sink = sink + pattern.buildEvents().times.size();
+    });
+}
+
+Benchmark::Result Benchmark::runParallelBuild(int numNotes, int numThreads) {
+    auto pattern = createPattern(numNotes);
+    ArpParallelBuilder builder(numThreads);
+    return runRepeated("parallelBuild-" + String(numThreads), numNotes, [&]() {
+        sink = sink + builder.build(pattern).times.size();
+    });
+}
+
+Benchmark::Result Benchmark::runToValueTree(int numNotes) {
+    auto pattern = createPattern(numNotes);
+    return runRepeated("toValueTree", numNotes, [&]() {
+        sink = sink + static_cast<size_t>(pattern.toValueTree().getNumChildren());
+    });
+}
+
+Benchmark::Result Benchmark::runFromValueTree(int numNotes) {
+    auto tree = createPattern(numNotes).toValueTree();
+    return runRepeated("fromValueTree", numNotes, [&]() {
+        sink = sink + ArpPattern::fromValueTree(tree).getNotes().size();
+    });
+}
+
+Benchmark::Result Benchmark::runWriteBinary(int numNotes) {
+    auto pattern = createPattern(numNotes);
+    return runRepeated("writeBinary", numNotes, [&]() {
+        MemoryOutputStream stream;
+        pattern.writeBinary(stream);
+        sink = sink + stream.getDataSize();
+    });
+}
+
+Benchmark::Result Benchmark::runReadBinary(int numNotes) {
+    MemoryOutputStream stream;
+    createPattern(numNotes).writeBinary(stream);
+    auto data = stream.getMemoryBlock();
+    return runRepeated("readBinary", numNotes, [&]() {
+        MemoryInputStream input(data, false);
+        sink = sink + ArpPattern::readBinary(input).getNotes().size();
+    });
+}
+
+Benchmark::Result Benchmark::runParseXml(int numNotes) {
+    auto xml = createPattern(numNotes).toValueTree().toXmlString();
+    return runRepeated("parseXml", numNotes, [&]() {
+        sink = sink + ArpPatternParser(xml).parse().getNotes().size();
+    });
+}
+
+
+ArpPattern Benchmark::createPattern(int numNotes) {
+    ArpPattern pattern;
+    auto timebase = pattern.getTimebase();
+    auto step = timebase / NOTES_PER_BEAT;
+
+    auto &notes = pattern.getNotes();
+    notes.reserve(static_cast<size_t>(numNotes));
+    for (int i = 0; i < numNotes; i++) {
+        ArpNote note;
+        note.data.noteNumber = i % NUM_NOTE_NUMBERS;
+        note.startPoint = static_cast<int64>(i) * step;
+        note.endPoint = note.startPoint + timebase / NOTE_LENGTH_BEATS_DIVISOR;
+        notes.push_back(note);
+    }
+
+    pattern.loopLength = jmax(static_cast<int64>(timebase), static_cast<int64>(numNotes) * step);
+    return pattern;
+}
+
+
+template <typename Function>
+Benchmark::Result Benchmark::runRepeated(const String &name, int numNotes, Function &&function) {
+    Result result;
+    result.name = name;
+    result.parameters = EngineCase { numNotes, 0, 0, false, false };
+
+    std::vector<double> times;
+    double totalSeconds = 0.0;
+    while (times.size() < static_cast<size_t>(MAX_PATTERN_ITERATIONS)
+            && (times.size() < static_cast<size_t>(this->minPatternIterations)
+                || totalSeconds < this->minPatternSeconds)) {
+        auto start = Time::getHighResolutionTicks();
+        function();
+        auto end = Time::getHighResolutionTicks();
+
+        auto seconds = Time::highResolutionTicksToSeconds(end - start);
+        totalSeconds += seconds;
+        times.push_back(seconds * 1e9);
+    }
+
+    computeStatistics(result, times);
+    return result;
+}
+
+void Benchmark::computeStatistics(Result &result, std::vector<double> &times) {
+    result.iterations = static_cast<int>(times.size());
+    if (times.empty()) {
+        return;
+    }
+
+    std::sort(times.begin(), times.end());
+
+    double total = 0.0;
+    for (auto time : times) {
+        total += time;
+    }
+
+    auto percentile = [&](double fraction) {
+        auto index = static_cast<size_t>(std::ceil(fraction * times.size())) - 1;
+        return times[jlimit(static_cast<size_t>(0), times.size() - 1, index)];
+    };
+
+    result.meanNs = total / times.size();
+    result.p50Ns = percentile(0.50);
+    result.p99Ns = percentile(0.99);
+    result.maxNs = times.back();
+}
@@ -0,0 +1,245 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <vector>
+#include "JuceHeader.h"
+#include "../../../Source/ArpEngine.h"
+#include "../../../Source/ArpParallelBuilder.h"
+#include "../../../Source/ArpPatternParser.h"
+
+/**
+ * Micro-benchmarks of the LibreArp engine.
+ *
+ * Every benchmark produces a Result holding its parameters and the distribution of the measured times. Engine cases
+ * time single blocks processed by ArpEngine, the other benchmarks time single calls of the pattern functions.
+ */
+class Benchmark {
+public:
+
+    /**
+     * The parameters of an engine benchmark case.
+     */
+    class EngineCase {
+    public:
+
+        /**
+         * The number of notes in the pattern.
+         */
+        int numNotes;
+
+        /**
+         * The number of samples per block.
+         */
+        int blockSize;
+
+        /**
+         * The number of held input notes.
+         */
+        int chordSize;
+
+        /**
+         * Whether the loop resets.
+         */
+        bool loopReset;
+
+        /**
+         * Whether octaves are transposed on note overflow.
+         */
+        bool octaves;
+    };
+
+    /**
+     * The result of a benchmark.
+     */
+    class Result {
+    public:
+
+        /**
+         * The name of the benchmark.
+         */
+        String name;
+
+        /**
+         * The parameters of the case. Only numNotes is meaningful for pattern benchmarks.
+         */
+        EngineCase parameters;
+
+        /**
+         * The number of measured iterations.
+         */
+        int iterations = 0;
+
+        /**
+         * The number of MIDI events produced, for engine benchmarks.
+         */
+        int64 numEvents = 0;
+
+        /**
+         * The mean time of an iteration in nanoseconds.
+         */
+        double meanNs = 0.0;
+
+        /**
+         * The median time of an iteration in nanoseconds.
+         */
+        double p50Ns = 0.0;
+
+        /**
+         * The 99th percentile time of an iteration in nanoseconds.
+         */
+        double p99Ns = 0.0;
+
+        /**
+         * The maximum time of an iteration in nanoseconds.
+         */
+        double maxNs = 0.0;
+    };
+
+
+
+    /**
+     * The sample rate engine cases run at.
+     */
+    double sampleRate = 44100.0;
+
+    /**
+     * The tempo engine cases run at.
+     */
+    double bpm = 120.0;
+
+    /**
+     * The number of measured blocks per engine case.
+     */
+    int numBlocks = 4096;
+
+    /**
+     * The number of blocks processed before measuring, so that the pattern is swapped in and the caches are warm.
+     */
+    int numWarmupBlocks = 64;
+
+    /**
+     * The minimum number of measured calls per pattern benchmark.
+     */
+    int minPatternIterations = 5;
+
+    /**
+     * The minimum total time measured per pattern benchmark, in seconds.
+     */
+    double minPatternSeconds = 0.2;
+
+
+
+    /**
+     * Times the processing of blocks by the engine.
+     *
+     * @param parameters the parameters of the case
+     * @return the result of the case
+     */
+    Result runEngine(const EngineCase &parameters);
+
+    /**
+     * Times ArpPattern::buildEvents.
+     *
+     * @param numNotes the number of notes in the pattern
+     * @return the result of the benchmark
+     */
+    Result runBuildEvents(int numNotes);
+
+    /**
+     * Times ArpParallelBuilder::build. The name of the result ends with the number of threads, so that the speed-up
+     * over the thread counts can be read off the results of the same pattern.
+     *
+     * @param numNotes the number of notes in the pattern
+     * @param numThreads the maximum number of threads to build with
+     * @return the result of the benchmark
+     */
+    Result runParallelBuild(int numNotes, int numThreads);
+
+    /**
+     * Times ArpPattern::toValueTree.
+     *
+     * @param numNotes the number of notes in the pattern
+     * @return the result of the benchmark
+     */
+    Result runToValueTree(int numNotes);
+
+    /**
+     * Times ArpPattern::fromValueTree.
+     *
+     * @param numNotes the number of notes in the pattern
+     * @return the result of the benchmark
+     */
+    Result runFromValueTree(int numNotes);
+
+    /**
+     * Times ArpPattern::writeBinary.
+     *
+     * @param numNotes the number of notes in the pattern
+     * @return the result of the benchmark
+     */
+    Result runWriteBinary(int numNotes);
+
+    /**
+     * Times ArpPattern::readBinary.
+     *
+     * @param numNotes the number of notes in the pattern
+     * @return the result of the benchmark
+     */
+    Result runReadBinary(int numNotes);
+
+    /**
+     * Times ArpPatternParser::parse on the XML of a pattern.
+     *
+     * @param numNotes the number of notes in the pattern
+     * @return the result of the benchmark
+     */
+    Result runParseXml(int numNotes);
+
+
+
+    /**
+     * Creates a deterministic pattern with the specified number of notes. Notes are laid out eight per beat, each
+     * half a beat long, over eight pattern note numbers.
+     *
+     * @param numNotes the number of notes
+     * @return the created pattern
+     */
+    static ArpPattern createPattern(int numNotes);
+
+private:
+
+    /**
+     * Times a function repeatedly, for at least minPatternIterations calls and minPatternSeconds.
+     *
+     * @param name the name of the benchmark
+     * @param numNotes the number of notes in the benchmarked pattern
+     * @param function the function to time
+     * @return the result of the benchmark
+     */
+    template <typename Function>
+    Result runRepeated(const String &name, int numNotes, Function &&function);
+
+    /**
+     * Fills in the statistics of a result from the measured times.
+     *
+     * @param result the result to fill in
+     * @param times the measured times in nanoseconds, sorted in place
+     */
+    static void computeStatistics(Result &result, std::vector<double> &times);
+};
@@ -0,0 +1,168 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <iostream>
+#include "JuceHeader.h"
+#include "Benchmark.h"
+
+const int PATTERN_SIZES[] = { 10, 100, 1000, 10000, 100000 };
+const int BLOCK_SIZES[] = { 16, 64, 256, 1024, 4096 };
+const int CHORD_SIZES[] = { 1, 4, 16 };
+
+const char *USAGE =
+        "Usage: LibreArpBenchmark [options]\n"
+        "\n"
+        "Times the LibreArp engine across a matrix of pattern, block and chord sizes, and the pattern\n"
+        "build and serialization functions. The parallel build is timed at doubling thread counts up to\n"
+        "the number of cores.\n"
+        "\n"
+        "Options:\n"
+        "    --format <csv|json>     output format (default csv)\n"
+        "    --output <file>         file to write the results into (default: standard output)\n"
+        "    --blocks <n>            number of measured blocks per engine case (default 4096)\n"
+        "    --max-notes <n>         skip patterns with more notes (default 100000)\n";
+
+/**
+ * Formats a result as a CSV row.
+ */
+static String toCsv(const Benchmark::Result &result) {
+    auto &parameters = result.parameters;
+    StringArray fields;
+    fields.add(result.name);
+    fields.add(String(parameters.numNotes));
+    fields.add(String(parameters.blockSize));
+    fields.add(String(parameters.chordSize));
+    fields.add(String(parameters.loopReset ? 1 : 0));
+    fields.add(String(parameters.octaves ? 1 : 0));
+    fields.add(String(result.iterations));
+    fields.add(String(result.numEvents));
+    fields.add(String(result.meanNs, 1));
+    fields.add(String(result.p50Ns, 1));
+    fields.add(String(result.p99Ns, 1));
+    fields.add(String(result.maxNs, 1));
+    return fields.joinIntoString(",");
+}
+
+/**
+ * Formats a result as a JSON object.
+ */
+static String toJson(const Benchmark::Result &result) {
+    auto &parameters = result.parameters;
+    return "{\"name\":\"" + result.name + "\""
+            + ",\"notes\":" + String(parameters.numNotes)
+            + ",\"blockSize\":" + String(parameters.blockSize)
+            + ",\"chordSize\":" + String(parameters.chordSize)
+            + ",\"loopReset\":" + (parameters.loopReset ? "true" : "false")
+            + ",\"octaves\":" + (parameters.octaves ? "true" : "false")
+            + ",\"iterations\":" + String(result.iterations)
+            + ",\"events\":" + String(result.numEvents)
+            + ",\"meanNs\":" + String(result.meanNs, 1)
+            + ",\"p50Ns\":" + String(result.p50Ns, 1)
+            + ",\"p99Ns\":" + String(result.p99Ns, 1)
+            + ",\"maxNs\":" + String(result.maxNs, 1)
+            + "}";
+}
+
+int main(int argc, char *argv[]) {
+    StringArray args;
+    for (int i = 1; i < argc; i++) {
+        args.add(String::fromUTF8(argv[i]));
+    }
+
+    Benchmark benchmark;
+    bool json = false;
+    int maxNotes = PATTERN_SIZES[numElementsInArray(PATTERN_SIZES) - 1];
+    File outputFile;
+
+    for (int i = 0; i < args.size(); i++) {
+        auto hasValue = i + 1 < args.size();
+        if (args[i] == "--format" && hasValue && (args[i + 1] == "csv" || args[i + 1] == "json")) {
+            json = args[++i] == "json";
+        } else if (args[i] == "--output" && hasValue) {
+            outputFile = File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+        } else if (args[i] == "--blocks" && hasValue && args[i + 1].getIntValue() > 0) {
+            benchmark.numBlocks = args[++i].getIntValue();
+        } else if (args[i] == "--max-notes" && hasValue && args[i + 1].getIntValue() > 0) {
+            maxNotes = args[++i].getIntValue();
+        } else {
+            std::cerr << USAGE;
+            return (args[i] == "--help" || args[i] == "-h") ? 0 : 1;
+        }
+    }
+
+    // Doubling thread counts up to the number of cores, to show how the parallel build scales
+    std::vector<int> threadCounts;
+    for (int numThreads = 1; numThreads < SystemStats::getNumCpus(); numThreads *= 2) {
+        threadCounts.push_back(numThreads);
+    }
+    threadCounts.push_back(SystemStats::getNumCpus());
+
+    std::vector<Benchmark::Result> results;
+    for (auto numNotes : PATTERN_SIZES) {
+        if (numNotes > maxNotes) {
+            continue;
+        }
+
+        std::cerr << "Pattern of " << numNotes << " notes" << std::endl;
+        results.push_back(benchmark.runBuildEvents(numNotes));
+        for (auto numThreads : threadCounts) {
+            results.push_back(benchmark.runParallelBuild(numNotes, numThreads));
+        }
+        results.push_back(benchmark.runToValueTree(numNotes));
+        results.push_back(benchmark.runFromValueTree(numNotes));
+        results.push_back(benchmark.runWriteBinary(numNotes));
+        results.push_back(benchmark.runReadBinary(numNotes));
+        results.push_back(benchmark.runParseXml(numNotes));
+
+        for (auto blockSize : BLOCK_SIZES) {
+            for (auto chordSize : CHORD_SIZES) {
+                for (auto loopReset : { false, true }) {
+                    for (auto octaves : { false, true }) {
+                        results.push_back(benchmark.runEngine(
+                                Benchmark::EngineCase { numNotes, blockSize, chordSize, loopReset, octaves }));
+                    }
+                }
+            }
+        }
+    }
+
+    StringArray lines;
+    if (json) {
+        StringArray objects;
+        for (auto &result : results) {
+            objects.add("  " + toJson(result));
+        }
+        lines.add("[");
+        lines.add(objects.joinIntoString(",\n"));
+        lines.add("]");
+    } else {
+        lines.add("name,notes,blockSize,chordSize,loopReset,octaves,iterations,events,meanNs,p50Ns,p99Ns,maxNs");
+        for (auto &result : results) {
+            lines.add(toCsv(result));
+        }
+    }
+
+    auto output = lines.joinIntoString("\n") + "\n";
+    if (outputFile == File()) {
+        std::cout << output;
+    } else if (!outputFile.replaceWithText(output)) {
+        std::cerr << "Could not write " << outputFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "ChordTimeline.h"
+#include "../../../Source/exception/ArpIntegrityException.h"
+
+double ChordTimeline::getLastBeat() const {
+    return this->changes.empty() ? 0.0 : this->changes.back().beat;
+}
+
+ChordTimeline ChordTimeline::parse(const String &text) {
+    ChordTimeline result;
+
+    auto lines = StringArray::fromLines(text);
+    for (int i = 0; i < lines.size(); i++) {
+        auto line = lines[i].trim();
+        if (line.isEmpty() || line.startsWithChar('#')) {
+            continue;
+        }
+
+        auto tokens = StringArray::fromTokens(line, false);
+        tokens.removeEmptyStrings();
+
+        auto lineNumber = String(i + 1);
+        if (!tokens[0].containsOnly("0123456789.")) {
+            throw ArpIntegrityException(("Chord timeline line " + lineNumber + ": invalid beat position!").toStdString());
+        }
+
+        Change change;
+        change.beat = tokens[0].getDoubleValue();
+        if (!result.changes.empty() && change.beat < result.changes.back().beat) {
+            throw ArpIntegrityException(("Chord timeline line " + lineNumber + ": changes out of order!").toStdString());
+        }
+
+        for (int j = 1; j < tokens.size(); j++) {
+            auto note = tokens[j].getIntValue();
+            if (!tokens[j].containsOnly("0123456789") || note > 127) {
+                throw ArpIntegrityException(("Chord timeline line " + lineNumber + ": invalid note!").toStdString());
+            }
+            change.notes.push_back(note);
+        }
+
+        result.changes.push_back(change);
+    }
+
+    return result;
+}
@@ -0,0 +1,79 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <vector>
+#include "JuceHeader.h"
+
+/**
+ * A timeline of chords held on the input of the arpeggiator.
+ *
+ * The timeline is read from text, one chord change per line. Each line starts with the position of the change in
+ * beats, followed by the MIDI note numbers held from that position on. A line with no notes releases all the notes.
+ * Empty lines and lines starting with '#' are ignored. For example:
+ *
+ *     # beat  notes
+ *     0       60 64 67
+ *     4       62 65 69
+ *     8
+ */
+class ChordTimeline {
+public:
+
+    /**
+     * A single chord change.
+     */
+    class Change {
+    public:
+
+        /**
+         * The position of the change in beats.
+         */
+        double beat;
+
+        /**
+         * The MIDI note numbers held from the change on.
+         */
+        std::vector<int> notes;
+    };
+
+
+
+    /**
+     * The chord changes in ascending order of position.
+     */
+    std::vector<Change> changes;
+
+
+
+    /**
+     * Gets the position of the last chord change.
+     *
+     * @return the position of the last chord change in beats, zero if there are no changes
+     */
+    double getLastBeat() const;
+
+    /**
+     * Parses a timeline from text.
+     *
+     * @param text the text to parse
+     * @return the parsed timeline
+     * @throws ArpIntegrityException if the text is malformed
+     */
+    static ChordTimeline parse(const String &text);
+};
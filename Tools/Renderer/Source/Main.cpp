@@ -0,0 +1,370 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <iostream>
+#include "JuceHeader.h"
+#include "../../../Source/ArpEngine.h"
+#include "../../../Source/debug/AllocationTracker.h"
+#include "../../../Source/exception/ArpIntegrityException.h"
+#include "ChordTimeline.h"
+#include "OfflineRenderer.h"
+
+const char *USAGE =
+        "Usage: LibreArpRenderer <pattern> <chords> <output.mid> [options]\n"
+        "\n"
+        "Renders a LibreArp pattern played over a chord timeline into a Standard MIDI File.\n"
+        "\n"
+        "    <pattern>               pattern XML or saved plugin state\n"
+        "    <chords>                chord timeline, one '<beat> <note>...' change per line\n"
+        "    <output.mid>            the MIDI file to write\n"
+        "\n"
+        "Options:\n"
+        "    --tempo <bpm>           tempo in beats per minute (default 120)\n"
+        "    --end-tempo <bpm>       tempo at the end of the render, ramped to linearly from --tempo\n"
+        "    --sample-rate <hz>      sample rate of the engine (default 44100)\n"
+        "    --block-size <samples>  number of samples per processed block (default 512)\n"
+        "    --length <beats>        length of the render (default: the last chord change)\n"
+        "    --ppq <ticks>           resolution of the MIDI file (default 960)\n"
+        "    --timebase <ppq>        resolution to rescale the pattern to before playing it, e.g. 960 or 1920\n"
+        "    --loop-reset <beats>    beats after which the loop resets, 0 to disable\n"
+        "    --octaves <on|off>      whether octaves are transposed on note overflow\n"
+        "    --channel <1-16>        MIDI channel output notes are sent into\n"
+        "    --transpose <semitones> transposition of the chord notes (default 0)\n"
+        "    --velocity-scaling <on|off>\n"
+        "                            whether pattern velocities are scaled by the played velocity\n"
+        "    --deterministic <on|off>\n"
+        "                            whether the output is independent of the block size\n"
+        "    --verify                also render at several block sizes in deterministic mode and check that the\n"
+        "                            outputs are identical and pair their notes, then run the built-in playback\n"
+        "                            checks. Debug builds also check that the engine never allocates.\n";
+
+const int VERIFY_BLOCK_SIZES[] = { 1, 7, 32, 64, 511, 4096 };
+const int CHECK_TIMEBASE = 96;
+const int CHECK_LOOP_LENGTH = 4 * CHECK_TIMEBASE; // One bar of 4/4
+const int CHECK_CHORD_NOTE = 60;
+
+/**
+ * Loads the pattern and engine settings from a pattern XML or a saved plugin state.
+ */
+static ArpPattern loadPattern(ArpEngine &engine, const File &file) {
+    if (!file.existsAsFile()) {
+        throw std::invalid_argument(("File not found: " + file.getFullPathName()).toStdString());
+    }
+
+    std::unique_ptr<XmlElement> doc(XmlDocument::parse(file.loadFileAsString()));
+    if (doc == nullptr) {
+        throw ArpIntegrityException("Malformed XML!");
+    }
+
+    ValueTree tree = ValueTree::fromXml(*doc);
+    ValueTree patternTree = tree;
+    if (!tree.hasType(ArpPattern::TREEID_PATTERN)) {
+        patternTree = tree.getChildWithName(ArpPattern::TREEID_PATTERN);
+        engine.readState(tree);
+    }
+
+    return ArpPattern::fromValueTree(patternTree);
+}
+
+/**
+ * Finds the first event at which two sequences timestamped in samples differ.
+ *
+ * @return the index of the first differing event, or -1 if the sequences are identical
+ */
+static int findMismatch(const MidiMessageSequence &expected, const MidiMessageSequence &actual) {
+    auto numEvents = jmin(expected.getNumEvents(), actual.getNumEvents());
+    for (int i = 0; i < numEvents; i++) {
+        auto &a = expected.getEventPointer(i)->message;
+        auto &b = actual.getEventPointer(i)->message;
+        if (a.getTimeStamp() != b.getTimeStamp()
+                || a.getRawDataSize() != b.getRawDataSize()
+                || memcmp(a.getRawData(), b.getRawData(), static_cast<size_t>(a.getRawDataSize())) != 0) {
+            return i;
+        }
+    }
+    return (expected.getNumEvents() == actual.getNumEvents()) ? -1 : numEvents;
+}
+
+/**
+ * Finds the first note message that does not alternate with the previous one of its channel and note, that is, a
+ * note on of a sounding note or a note off of a silent one.
+ *
+ * @return the index of the first unpaired event, the number of events if a note is left sounding, or -1 if all the
+ * notes are paired
+ */
+static int findUnpairedNote(const MidiMessageSequence &sequence) {
+    bool sounding[16][128] = {};
+    int numSounding = 0;
+    for (int i = 0; i < sequence.getNumEvents(); i++) {
+        auto &message = sequence.getEventPointer(i)->message;
+        if (!message.isNoteOnOrOff()) {
+            continue;
+        }
+
+        auto &slot = sounding[message.getChannel() - 1][message.getNoteNumber()];
+        if (slot == message.isNoteOn()) {
+            return i;
+        }
+        slot = message.isNoteOn();
+        numSounding += slot ? 1 : -1;
+    }
+    return (numSounding == 0) ? -1 : sequence.getNumEvents();
+}
+
+/**
+ * Adds a note to a pattern built for a playback check.
+ */
+static void addCheckNote(ArpPattern &pattern, int noteNumber, int64 startPoint, int64 endPoint) {
+    ArpNote note;
+    note.data.noteNumber = noteNumber;
+    note.startPoint = startPoint;
+    note.endPoint = endPoint;
+    pattern.getNotes().push_back(note);
+}
+
+/**
+ * Checks whether a rendered message falls on the specified beat, give or take the rounding of its sample offset.
+ */
+static bool isAtBeat(const OfflineRenderer &renderer, const MidiMessage &message, double beat) {
+    return std::abs(message.getTimeStamp() - beat * 60.0 * renderer.sampleRate / renderer.bpm) <= 1.0;
+}
+
+/**
+ * Renders a playback check with a fresh engine.
+ */
+static MidiMessageSequence renderCheck(OfflineRenderer renderer, ArpPattern &pattern, const ChordTimeline &timeline) {
+    ArpEngine engine;
+    engine.setDeterministic(true);
+    engine.compile(pattern);
+    renderer.length = timeline.getLastBeat();
+    return renderer.render(engine, timeline);
+}
+
+/**
+ * Checks that two voices of the pattern sounding the same MIDI note at once send it as a single note, started by the
+ * first voice and stopped by the last one.
+ *
+ * @return true if the check passed
+ */
+static bool checkSharedNote(const OfflineRenderer &renderer) {
+    ArpPattern pattern(CHECK_TIMEBASE);
+    pattern.loopLength = CHECK_LOOP_LENGTH;
+    addCheckNote(pattern, 0, 0, 2 * CHECK_TIMEBASE);
+    addCheckNote(pattern, 0, CHECK_TIMEBASE, 3 * CHECK_TIMEBASE);
+
+    ChordTimeline timeline;
+    timeline.changes.push_back({ 0.0, { CHECK_CHORD_NOTE } });
+    timeline.changes.push_back({ 4.0, {} });
+
+    auto sequence = renderCheck(renderer, pattern, timeline);
+    return sequence.getNumEvents() == 2
+            && findUnpairedNote(sequence) < 0
+            && isAtBeat(renderer, sequence.getEventPointer(1)->message, 3.0);
+}
+
+/**
+ * Checks that a chord pressed while the transport is playing starts the notes of the pattern at their next onset,
+ * rather than the ones already under way.
+ *
+ * @return true if the check passed
+ */
+static bool checkLateChord(const OfflineRenderer &renderer) {
+    ArpPattern pattern(CHECK_TIMEBASE);
+    pattern.loopLength = CHECK_LOOP_LENGTH;
+    addCheckNote(pattern, 0, 0, 2 * CHECK_TIMEBASE);
+
+    ChordTimeline timeline;
+    timeline.changes.push_back({ 1.0, { CHECK_CHORD_NOTE } });
+    timeline.changes.push_back({ 8.0, {} });
+
+    auto sequence = renderCheck(renderer, pattern, timeline);
+    return sequence.getNumEvents() == 2
+            && findUnpairedNote(sequence) < 0
+            && isAtBeat(renderer, sequence.getEventPointer(0)->message, 4.0);
+}
+
+/**
+ * Renders the timeline at each of the VERIFY_BLOCK_SIZES in deterministic mode, with fresh engines set up like the
+ * specified one, and checks that all the renders are identical to the first and that their notes are paired. Then
+ * runs the built-in playback checks. If allocations are tracked, also checks that none of the renders allocated
+ * while processing.
+ *
+ * @return true if all the renders are identical and paired, all the checks passed and nothing was allocated
+ */
+static bool verify(ArpEngine &engine, ArpPattern &pattern, OfflineRenderer renderer, const ChordTimeline &timeline) {
+    ValueTree state("engineState");
+    engine.writeState(state);
+
+#if LIBREARP_TRACK_ALLOCATIONS
+    AllocationTracker::reset();
+#endif
+
+    MidiMessageSequence reference;
+    bool passed = true;
+    for (auto blockSize : VERIFY_BLOCK_SIZES) {
+        ArpEngine blockEngine;
+        blockEngine.readState(state);
+        blockEngine.setDeterministic(true);
+        blockEngine.compile(pattern);
+
+        renderer.blockSize = blockSize;
+        auto sequence = renderer.render(blockEngine, timeline);
+        if (blockSize == VERIFY_BLOCK_SIZES[0]) {
+            reference = sequence;
+            std::cout << "block size " << blockSize << ": " << sequence.getNumEvents() << " events" << std::endl;
+
+            auto unpaired = findUnpairedNote(sequence);
+            if (unpaired >= 0) {
+                std::cout << "block size " << blockSize << ": unpaired note at event " << unpaired << std::endl;
+                passed = false;
+            }
+            continue;
+        }
+
+        auto mismatch = findMismatch(reference, sequence);
+        if (mismatch < 0) {
+            std::cout << "block size " << blockSize << ": identical" << std::endl;
+        } else {
+            std::cout << "block size " << blockSize << ": differs at event " << mismatch << std::endl;
+            passed = false;
+        }
+    }
+
+    auto sharedNote = checkSharedNote(renderer);
+    std::cout << "shared note: " << (sharedNote ? "ok" : "failed") << std::endl;
+
+    auto lateChord = checkLateChord(renderer);
+    std::cout << "late chord: " << (lateChord ? "ok" : "failed") << std::endl;
+
+#if LIBREARP_TRACK_ALLOCATIONS
+    auto numAllocations = AllocationTracker::getNumAllocations();
+    std::cout << "audio thread allocations: " << numAllocations << std::endl;
+    AllocationTracker::report();
+    passed = passed && numAllocations == 0;
+#endif
+
+    return passed && sharedNote && lateChord;
+}
+
+/**
+ * Gets the value of a numeric option, checking its range.
+ */
+static double getOption(const StringArray &args, int &index, double min, double max) {
+    auto name = args[index];
+    if (++index >= args.size()) {
+        throw std::invalid_argument(("Missing value of " + name).toStdString());
+    }
+
+    auto value = args[index].getDoubleValue();
+    if (!args[index].containsOnly("-0123456789.") || value < min || value > max) {
+        throw std::invalid_argument(("Invalid value of " + name + ": " + args[index]).toStdString());
+    }
+    return value;
+}
+
+int main(int argc, char *argv[]) {
+    StringArray args;
+    for (int i = 1; i < argc; i++) {
+        args.add(String::fromUTF8(argv[i]));
+    }
+
+    if (args.size() < 3 || args.contains("--help") || args.contains("-h")) {
+        std::cerr << USAGE;
+        return (args.size() < 3) ? 1 : 0;
+    }
+
+    try {
+        auto workingDirectory = File::getCurrentWorkingDirectory();
+        auto patternFile = workingDirectory.getChildFile(args[0]);
+        auto chordsFile = workingDirectory.getChildFile(args[1]);
+        auto outputFile = workingDirectory.getChildFile(args[2]);
+
+        ArpEngine engine;
+        OfflineRenderer renderer;
+        auto pattern = loadPattern(engine, patternFile);
+        bool verifyBlockSizes = false;
+
+        for (int i = 3; i < args.size(); i++) {
+            if (args[i] == "--tempo") {
+                renderer.bpm = getOption(args, i, 1.0, 1000.0);
+            } else if (args[i] == "--end-tempo") {
+                renderer.endBpm = getOption(args, i, 1.0, 1000.0);
+            } else if (args[i] == "--sample-rate") {
+                renderer.sampleRate = getOption(args, i, 1000.0, 1000000.0);
+            } else if (args[i] == "--block-size") {
+                renderer.blockSize = static_cast<int>(getOption(args, i, 1, 65536));
+            } else if (args[i] == "--length") {
+                renderer.length = getOption(args, i, 0.0, 1000000.0);
+            } else if (args[i] == "--ppq") {
+                renderer.ticksPerQuarterNote = static_cast<int>(getOption(args, i, 1, 32767));
+            } else if (args[i] == "--timebase") {
+                pattern.setTimebase(static_cast<int>(getOption(args, i, 1, 65536)));
+            } else if (args[i] == "--loop-reset") {
+                engine.setLoopReset(getOption(args, i, 0.0, 1000000.0));
+            } else if (args[i] == "--channel") {
+                engine.setOutputMidiChannel(static_cast<int>(getOption(args, i, 1, 16)));
+            } else if (args[i] == "--octaves" && i + 1 < args.size()) {
+                engine.setOctaves(args[++i] != "off");
+            } else if (args[i] == "--transpose") {
+                engine.setTranspose(static_cast<int>(getOption(args, i, -127, 127)));
+            } else if (args[i] == "--velocity-scaling" && i + 1 < args.size()) {
+                engine.setVelocityScaling(args[++i] != "off");
+            } else if (args[i] == "--deterministic" && i + 1 < args.size()) {
+                engine.setDeterministic(args[++i] != "off");
+            } else if (args[i] == "--verify") {
+                verifyBlockSizes = true;
+            } else {
+                throw std::invalid_argument(("Unknown option: " + args[i]).toStdString());
+            }
+        }
+
+        engine.compile(pattern);
+
+        if (!chordsFile.existsAsFile()) {
+            throw std::invalid_argument(("File not found: " + chordsFile.getFullPathName()).toStdString());
+        }
+
+        auto timeline = ChordTimeline::parse(chordsFile.loadFileAsString());
+        auto startTicks = Time::getHighResolutionTicks();
+        auto sequence = renderer.render(engine, timeline);
+        auto totalSeconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks);
+
+        if (!renderer.writeMidiFile(sequence, outputFile)) {
+            std::cerr << "Could not write " << outputFile.getFullPathName() << std::endl;
+            return 1;
+        }
+
+        auto eventsPerSecond = (renderer.processingSeconds > 0.0)
+                ? renderer.numEvents / renderer.processingSeconds
+                : 0.0;
+        std::cout << "blocks: " << renderer.numBlocks << std::endl
+                  << "events: " << renderer.numEvents << std::endl
+                  << "processing seconds: " << renderer.processingSeconds << std::endl
+                  << "total seconds: " << totalSeconds << std::endl
+                  << "events per second: " << eventsPerSecond << std::endl;
+
+        if (verifyBlockSizes && !verify(engine, pattern, renderer, timeline)) {
+            std::cerr << "Verification failed" << std::endl;
+            return 1;
+        }
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
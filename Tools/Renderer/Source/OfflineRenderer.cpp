@@ -0,0 +1,193 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "OfflineRenderer.h"
+
+const int NUM_MIDI_NOTES = 128;
+const int MICROSECONDS_PER_MINUTE = 60000000;
+const int TEMPO_RAMP_STEP = 1000; // not a power of two, so that the tempo changes fall inside of the blocks
+const size_t MIDI_BUFFER_SIZE = 1 << 20; // bytes, preallocated like the reused buffer of a host
+
+MidiMessageSequence OfflineRenderer::render(ArpEngine &engine, const ChordTimeline &timeline) {
+    jassert(this->blockSize > 0);
+
+    auto endBeat = (this->length > 0.0) ? this->length : timeline.getLastBeat();
+    buildTempoRamp(endBeat);
+    auto endSample = beatToSample(endBeat);
+
+    engine.prepare(this->sampleRate, this->blockSize);
+
+    MidiMessageSequence sequence;
+    MidiBuffer midi;
+    midi.ensureSize(MIDI_BUFFER_SIZE);
+    bool held[NUM_MIDI_NOTES] = {};
+    size_t nextChange = 0;
+
+    // Chords are played on the channel the engine reads from, so that they are never passed through
+    auto inputChannel = jmax(1, engine.getInputMidiChannel());
+
+    ArpEngine::Transport transport;
+    transport.isPlaying = true;
+    transport.bpm = this->bpm;
+
+    this->numBlocks = 0;
+    this->numEvents = 0;
+    int64 ticks = 0;
+
+    for (int64 blockStart = 0; blockStart < endSample; blockStart += this->blockSize) {
+        auto numSamples = static_cast<int>(jmin(static_cast<int64>(this->blockSize), endSample - blockStart));
+
+        // Feed the chord changes falling into the block as input note messages
+        midi.clear();
+        while (nextChange < timeline.changes.size()
+                && beatToSample(timeline.changes[nextChange].beat) < blockStart + numSamples) {
+            auto &change = timeline.changes[nextChange++];
+            auto offset = static_cast<int>(jmax(static_cast<int64>(0), beatToSample(change.beat) - blockStart));
+
+            bool next[NUM_MIDI_NOTES] = {};
+            for (auto note : change.notes) {
+                next[note] = true;
+            }
+
+            for (int note = 0; note < NUM_MIDI_NOTES; note++) {
+                if (held[note] && !next[note]) {
+                    midi.addEvent(MidiMessage::noteOff(inputChannel, note), offset);
+                } else if (!held[note] && next[note]) {
+                    midi.addEvent(MidiMessage::noteOn(inputChannel, note, 1.0f), offset);
+                }
+                held[note] = next[note];
+            }
+        }
+
+        transport.ppqPosition = sampleToBeat(blockStart);
+        transport.numTempoChanges = 0;
+        if (!this->rampBpms.empty()) {
+            auto step = static_cast<size_t>(blockStart / TEMPO_RAMP_STEP);
+            transport.bpm = this->rampBpms[step];
+            for (auto change = static_cast<int64>(step + 1) * TEMPO_RAMP_STEP; change < blockStart + numSamples
+                    && transport.numTempoChanges < ArpEngine::Transport::MAX_TEMPO_CHANGES; change += TEMPO_RAMP_STEP) {
+                auto &tempoChange = transport.tempoChanges[transport.numTempoChanges++];
+                tempoChange.sample = static_cast<int>(change - blockStart);
+                tempoChange.bpm = this->rampBpms[++step];
+            }
+        }
+
+        auto startTicks = Time::getHighResolutionTicks();
+        engine.process(transport, numSamples, midi, true);
+        ticks += Time::getHighResolutionTicks() - startTicks;
+
+        collect(midi, blockStart, sequence);
+        this->numBlocks++;
+    }
+
+    // Stop the transport so that the engine releases its voices
+    midi.clear();
+    transport.isPlaying = false;
+    engine.process(transport, 1, midi, true);
+    collect(midi, endSample, sequence);
+
+    this->processingSeconds = Time::highResolutionTicksToSeconds(ticks);
+
+    sequence.updateMatchedPairs();
+    return sequence;
+}
+
+bool OfflineRenderer::writeMidiFile(const MidiMessageSequence &sequence, const File &file) {
+    MidiMessageSequence track;
+    track.addEvent(MidiMessage::tempoMetaEvent(static_cast<int>(MICROSECONDS_PER_MINUTE / this->bpm)));
+    for (size_t step = 1; step < this->rampBpms.size(); step++) {
+        auto tempo = MidiMessage::tempoMetaEvent(static_cast<int>(MICROSECONDS_PER_MINUTE / this->rampBpms[step]));
+        tempo.setTimeStamp(std::round(this->rampBeats[step] * this->ticksPerQuarterNote));
+        track.addEvent(tempo);
+    }
+    for (int i = 0; i < sequence.getNumEvents(); i++) {
+        MidiMessage message = sequence.getEventPointer(i)->message;
+        message.setTimeStamp(std::round(sampleToTick(static_cast<int64>(message.getTimeStamp()))));
+        track.addEvent(message);
+    }
+    track.updateMatchedPairs();
+
+    MidiFile midiFile;
+    midiFile.setTicksPerQuarterNote(this->ticksPerQuarterNote);
+    midiFile.addTrack(track);
+
+    // FileOutputStream appends to existing files
+    if (!file.deleteFile()) {
+        return false;
+    }
+
+    FileOutputStream stream(file);
+    return stream.openedOk() && midiFile.writeTo(stream);
+}
+
+
+void OfflineRenderer::buildTempoRamp(double endBeat) {
+    this->rampBeats.clear();
+    this->rampBpms.clear();
+    if (this->endBpm <= 0.0) {
+        return;
+    }
+
+    // The tempo is constant within each step, and the step after the end keeps the end tempo for the stopping block
+    double beat = 0.0;
+    do {
+        auto progress = (endBeat > 0.0) ? jmin(1.0, beat / endBeat) : 1.0;
+        auto stepBpm = this->bpm + (this->endBpm - this->bpm) * progress;
+        this->rampBeats.push_back(beat);
+        this->rampBpms.push_back(stepBpm);
+        beat += TEMPO_RAMP_STEP * stepBpm / (60.0 * this->sampleRate);
+    } while (this->rampBeats.back() < endBeat);
+}
+
+double OfflineRenderer::sampleToBeat(int64 sample) const {
+    if (this->rampBpms.empty()) {
+        return sample * this->bpm / (60.0 * this->sampleRate);
+    }
+
+    auto step = jmin(static_cast<size_t>(sample / TEMPO_RAMP_STEP), this->rampBpms.size() - 1);
+    auto stepStart = static_cast<int64>(step) * TEMPO_RAMP_STEP;
+    return this->rampBeats[step] + (sample - stepStart) * this->rampBpms[step] / (60.0 * this->sampleRate);
+}
+
+double OfflineRenderer::sampleToTick(int64 sample) const {
+    if (this->rampBpms.empty()) {
+        return sample * this->bpm * this->ticksPerQuarterNote / (60.0 * this->sampleRate);
+    }
+    return sampleToBeat(sample) * this->ticksPerQuarterNote;
+}
+
+int64 OfflineRenderer::beatToSample(double beat) const {
+    if (this->rampBpms.empty()) {
+        return static_cast<int64>(std::llround(beat * 60.0 * this->sampleRate / this->bpm));
+    }
+
+    auto it = std::upper_bound(this->rampBeats.begin(), this->rampBeats.end(), beat);
+    auto step = static_cast<size_t>(jmax(static_cast<ptrdiff_t>(0), it - this->rampBeats.begin() - 1));
+    auto stepStart = static_cast<int64>(step) * TEMPO_RAMP_STEP;
+    return stepStart + std::llround((beat - this->rampBeats[step]) * 60.0 * this->sampleRate / this->rampBpms[step]);
+}
+
+void OfflineRenderer::collect(MidiBuffer &midi, int64 blockStart, MidiMessageSequence &sequence) {
+    const uint8 *data;
+    int numBytes;
+    int sample;
+
+    for (MidiBuffer::Iterator i(midi); i.getNextEvent(data, numBytes, sample);) {
+        sequence.addEvent(MidiMessage(data, numBytes, static_cast<double>(blockStart + sample)));
+        this->numEvents++;
+    }
+}
@@ -0,0 +1,154 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <vector>
+#include "JuceHeader.h"
+#include "../../../Source/ArpEngine.h"
+#include "ChordTimeline.h"
+
+/**
+ * Renders the output of the arpeggiator engine offline, block by block, as fast as possible.
+ */
+class OfflineRenderer {
+public:
+
+    /**
+     * The tempo in beats per minute.
+     */
+    double bpm = 120.0;
+
+    /**
+     * The tempo at the end of the render, reached by a linear ramp from bpm. If not positive, the tempo is constant.
+     */
+    double endBpm = 0.0;
+
+    /**
+     * The sample rate the engine runs at.
+     */
+    double sampleRate = 44100.0;
+
+    /**
+     * The number of samples in a processed block.
+     */
+    int blockSize = 512;
+
+    /**
+     * The length of the render in beats. If not positive, the render ends at the last chord change.
+     */
+    double length = 0.0;
+
+    /**
+     * The resolution of the written MIDI file in ticks per quarter note.
+     */
+    int ticksPerQuarterNote = 960;
+
+
+
+    /**
+     * The number of blocks processed by the last render.
+     */
+    int64 numBlocks = 0;
+
+    /**
+     * The number of MIDI events produced by the last render.
+     */
+    int64 numEvents = 0;
+
+    /**
+     * The wall-clock time the engine spent processing during the last render, in seconds.
+     */
+    double processingSeconds = 0.0;
+
+
+
+    /**
+     * Renders the chord timeline through the engine. The engine has to have its pattern compiled already; all the
+     * notes it plays are stopped at the end of the render.
+     *
+     * @param engine the engine to render with
+     * @param timeline the chords held on the input
+     * @return the rendered sequence, timestamped in samples
+     */
+    MidiMessageSequence render(ArpEngine &engine, const ChordTimeline &timeline);
+
+    /**
+     * Writes a rendered sequence into a Standard MIDI File, along with the tempo. The timestamps are converted from
+     * samples to ticks.
+     *
+     * @param sequence the rendered sequence, timestamped in samples
+     * @param file the file to write, replaced if it exists
+     * @return true if the file has been written successfully
+     */
+    bool writeMidiFile(const MidiMessageSequence &sequence, const File &file);
+
+private:
+
+    /**
+     * The positions in beats of the steps of the tempo ramp, each TEMPO_RAMP_STEP samples long. Empty if the tempo
+     * is constant.
+     */
+    std::vector<double> rampBeats;
+
+    /**
+     * The tempos of the steps of the tempo ramp, in beats per minute.
+     */
+    std::vector<double> rampBpms;
+
+
+
+    /**
+     * Builds the steps of the tempo ramp up to the specified position.
+     *
+     * @param endBeat the end of the render in beats
+     */
+    void buildTempoRamp(double endBeat);
+
+    /**
+     * Converts a position in samples to beats.
+     *
+     * @param sample the position in samples
+     * @return the position in beats
+     */
+    double sampleToBeat(int64 sample) const;
+
+    /**
+     * Converts a position in samples to ticks.
+     *
+     * @param sample the position in samples
+     * @return the position in ticks
+     */
+    double sampleToTick(int64 sample) const;
+
+    /**
+     * Converts a position in beats to samples.
+     *
+     * @param beat the position in beats
+     * @return the position in samples
+     */
+    int64 beatToSample(double beat) const;
+
+    /**
+     * Appends all the events of a processed block to the sequence.
+     *
+     * @param midi the processed block
+     * @param blockStart the position of the block in samples
+     * @param sequence the sequence to append to
+     */
+    void collect(MidiBuffer &midi, int64 blockStart, MidiMessageSequence &sequence);
+};